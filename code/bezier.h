@@ -0,0 +1,224 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include "math/vec2.h"
+
+struct QuadraticBezier
+{
+    Vec2<float> p0;
+    Vec2<float> p1;
+    Vec2<float> p2;
+};
+
+struct CubicBezier
+{
+    Vec2<float> p0;
+    Vec2<float> p1;
+    Vec2<float> p2;
+    Vec2<float> p3;
+};
+
+// Pieces with up to this many segments are stepped with forward
+// differences, longer ones are split first
+const int MaxForwardSteps = 16;
+
+// Smaller tolerances (also 0, negative and NaN) are raised to this
+const float MinTolerance = 1e-3f;
+
+// Wang's formula: segments needed so that no point of the curve is further
+// than tolerance from the polyline, from the largest second difference of
+// the control points
+inline int BezierSegments(const float secondDifference, const float degreeFactor, const float tolerance)
+{
+    const float n = sqrtf(degreeFactor * secondDifference / (tolerance >= MinTolerance ? tolerance : MinTolerance));
+    return std::max((int) ceilf(n), 1);
+}
+
+inline float Length(const float x, const float y)
+{
+    return sqrtf(x * x + y * y);
+}
+
+// Appends the points of the curve after p0 (the caller has it already).
+// A piece that needs more than MaxForwardSteps segments is split in half
+// (de Casteljau), so the segment count follows the local curvature instead
+// of the worst case of the whole curve.
+inline void TessellateBezier(const QuadraticBezier& curve, const float tolerance, std::vector<Vec2<float> >* points)
+{
+    const float ax = curve.p0.x - 2 * curve.p1.x + curve.p2.x;
+    const float ay = curve.p0.y - 2 * curve.p1.y + curve.p2.y;
+    const int n = BezierSegments(Length(ax, ay), 0.25f, tolerance);
+    
+    if (n > MaxForwardSteps)
+    {
+        const Vec2<float> p01((curve.p0.x + curve.p1.x) * 0.5f, (curve.p0.y + curve.p1.y) * 0.5f);
+        const Vec2<float> p12((curve.p1.x + curve.p2.x) * 0.5f, (curve.p1.y + curve.p2.y) * 0.5f);
+        const Vec2<float> mid((p01.x + p12.x) * 0.5f, (p01.y + p12.y) * 0.5f);
+        const QuadraticBezier left = { curve.p0, p01, mid };
+        const QuadraticBezier right = { mid, p12, curve.p2 };
+        TessellateBezier(left, tolerance, points);
+        TessellateBezier(right, tolerance, points);
+        return;
+    }
+    
+    // P(t) = a t^2 + b t + p0 stepped by h = 1 / n
+    const float h = 1.0f / n;
+    const float bx = 2 * (curve.p1.x - curve.p0.x);
+    const float by = 2 * (curve.p1.y - curve.p0.y);
+    float x = curve.p0.x, y = curve.p0.y;
+    float dx = ax * h * h + bx * h, dy = ay * h * h + by * h;
+    const float ddx = 2 * ax * h * h, ddy = 2 * ay * h * h;
+    for (int i = 1; i < n; ++i)
+    {
+        x += dx;
+        y += dy;
+        dx += ddx;
+        dy += ddy;
+        points->push_back(Vec2<float>(x, y));
+    }
+    // The last one exactly, without the accumulated error
+    points->push_back(curve.p2);
+}
+
+inline void TessellateBezier(const CubicBezier& curve, const float tolerance, std::vector<Vec2<float> >* points)
+{
+    const float d0 = Length(curve.p0.x - 2 * curve.p1.x + curve.p2.x, curve.p0.y - 2 * curve.p1.y + curve.p2.y);
+    const float d1 = Length(curve.p1.x - 2 * curve.p2.x + curve.p3.x, curve.p1.y - 2 * curve.p2.y + curve.p3.y);
+    const int n = BezierSegments(std::max(d0, d1), 0.75f, tolerance);
+    
+    if (n > MaxForwardSteps)
+    {
+        const Vec2<float> p01((curve.p0.x + curve.p1.x) * 0.5f, (curve.p0.y + curve.p1.y) * 0.5f);
+        const Vec2<float> p12((curve.p1.x + curve.p2.x) * 0.5f, (curve.p1.y + curve.p2.y) * 0.5f);
+        const Vec2<float> p23((curve.p2.x + curve.p3.x) * 0.5f, (curve.p2.y + curve.p3.y) * 0.5f);
+        const Vec2<float> p012((p01.x + p12.x) * 0.5f, (p01.y + p12.y) * 0.5f);
+        const Vec2<float> p123((p12.x + p23.x) * 0.5f, (p12.y + p23.y) * 0.5f);
+        const Vec2<float> mid((p012.x + p123.x) * 0.5f, (p012.y + p123.y) * 0.5f);
+        const CubicBezier left = { curve.p0, p01, p012, mid };
+        const CubicBezier right = { mid, p123, p23, curve.p3 };
+        TessellateBezier(left, tolerance, points);
+        TessellateBezier(right, tolerance, points);
+        return;
+    }
+    
+    // P(t) = a t^3 + b t^2 + c t + p0 stepped by h = 1 / n
+    const float h = 1.0f / n;
+    const float h2 = h * h, h3 = h2 * h;
+    const float ax = -curve.p0.x + 3 * (curve.p1.x - curve.p2.x) + curve.p3.x;
+    const float ay = -curve.p0.y + 3 * (curve.p1.y - curve.p2.y) + curve.p3.y;
+    const float bx = 3 * (curve.p0.x - 2 * curve.p1.x + curve.p2.x);
+    const float by = 3 * (curve.p0.y - 2 * curve.p1.y + curve.p2.y);
+    const float cx = 3 * (curve.p1.x - curve.p0.x);
+    const float cy = 3 * (curve.p1.y - curve.p0.y);
+    float x = curve.p0.x, y = curve.p0.y;
+    float dx = ax * h3 + bx * h2 + cx * h, dy = ay * h3 + by * h2 + cy * h;
+    float ddx = 6 * ax * h3 + 2 * bx * h2, ddy = 6 * ay * h3 + 2 * by * h2;
+    const float dddx = 6 * ax * h3, dddy = 6 * ay * h3;
+    for (int i = 1; i < n; ++i)
+    {
+        x += dx;
+        y += dy;
+        dx += ddx;
+        dy += ddy;
+        ddx += dddx;
+        ddy += dddy;
+        points->push_back(Vec2<float>(x, y));
+    }
+    points->push_back(curve.p3);
+}
+
+// Tessellations of curves drawn before, as integer polylines, looked up by
+// their control points and tolerance. Entries not used since the previous
+// Evict are dropped by it, call it once per frame.
+class CurveCache
+{
+private:
+    // Control points, tolerance and the number of control points
+    static const int KeySize = 10;
+    
+    struct Entry
+    {
+        float                       key[KeySize];
+        std::vector<Vec2<int> >     points;
+        bool                        used;
+    };
+    
+    std::unordered_map<unsigned long long, Entry>   entries;
+    std::vector<Vec2<float> >                       scratch;
+    
+    // FNV-1a over the bytes of the key
+    static unsigned long long Hash(const float* key, const int count)
+    {
+        const unsigned char* bytes = (const unsigned char*) key;
+        unsigned long long hash = 14695981039346656037ULL;
+        for (int i = 0; i < count * (int) sizeof(float); ++i)
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        return hash;
+    }
+    
+    template<typename Curve>
+    const std::vector<Vec2<int> >& Lookup(const Curve& curve, const float tolerance)
+    {
+        // Quadratics leave the fourth point zero, the degree tells them
+        // apart from cubics
+        const int pointCount = sizeof(Curve) / sizeof(Vec2<float>);
+        float key[KeySize] = {};
+        memcpy(key, &curve, sizeof(Curve));
+        key[8] = tolerance;
+        key[9] = (float) pointCount;
+        
+        Entry& entry = this->entries[Hash(key, KeySize)];
+        entry.used = true;
+        if (!entry.points.empty() && memcmp(entry.key, key, sizeof(key)) == 0)
+            return entry.points;
+        
+        // New, or a hash collision that replaces the old curve
+        memcpy(entry.key, key, sizeof(key));
+        this->scratch.clear();
+        TessellateBezier(curve, tolerance, &this->scratch);
+        entry.points.clear();
+        entry.points.push_back(Vec2<int>((int) floorf(curve.p0.x + 0.5f), (int) floorf(curve.p0.y + 0.5f)));
+        for (int i = 0; i < (int) this->scratch.size(); ++i)
+        {
+            const Vec2<int> point((int) floorf(this->scratch[i].x + 0.5f), (int) floorf(this->scratch[i].y + 0.5f));
+            if (point.x != entry.points.back().x || point.y != entry.points.back().y)
+                entry.points.push_back(point);
+        }
+        return entry.points;
+    }
+    
+public:
+    const std::vector<Vec2<int> >& Get(const QuadraticBezier& curve, const float tolerance)
+    {
+        return this->Lookup(curve, tolerance);
+    }
+    
+    const std::vector<Vec2<int> >& Get(const CubicBezier& curve, const float tolerance)
+    {
+        return this->Lookup(curve, tolerance);
+    }
+    
+    void Evict()
+    {
+        for (std::unordered_map<unsigned long long, Entry>::iterator it = this->entries.begin(); it != this->entries.end(); )
+        {
+            if (!it->second.used)
+            {
+                it = this->entries.erase(it);
+            }
+            else
+            {
+                it->second.used = false;
+                ++it;
+            }
+        }
+    }
+    
+    void Clear()
+    {
+        this->entries.clear();
+    }
+};
\ No newline at end of file
@@ -0,0 +1,510 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include "math/vec3.h"
+#include "math/aabb.h"
+#include "math/frustum.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// 32 bytes, two per cache line
+struct BvhNode
+{
+    Aabb<float> bounds;
+    int leftFirst;      // Interior: index of the left child, right is leftFirst + 1
+                        // Leaf: first entry in the primitive index list
+    int count;          // Number of primitives, 0 for interior nodes
+
+    inline bool IsLeaf() const { return this->count > 0; }
+};
+
+// Bounding volume hierarchy over the bounding boxes of scene objects.
+// Built top-down with binned SAH, stored as a flat node array where
+// children are always allocated after (at higher indices than) their
+// parent, which lets Refit() run as one backward loop.
+class Bvh
+{
+private:
+    static const int BinCount = 16;
+    static const int MaxLeafSize = 4;
+    static const int StackSize = 64;
+    static const int ParallelThreshold = 4096;
+
+    std::vector<BvhNode>        nodes;
+    std::vector<int>            indices;        // Primitive ids, leaves point into this
+    std::vector<Aabb<float> >   boxes;
+    std::vector<Vec3<float> >   centroids;
+    int                         nodeCount;
+
+    struct Bin
+    {
+        Aabb<float> bounds;
+        int count;
+    };
+
+    int AllocateNodePair()
+    {
+        int index;
+        #pragma omp critical(BvhAllocate)
+        {
+            index = this->nodeCount;
+            this->nodeCount += 2;
+        }
+
+        return index;
+    }
+
+    void UpdateBounds(int nodeIndex)
+    {
+        BvhNode& node = this->nodes[nodeIndex];
+        node.bounds = Aabb<float>();
+        for (int i = 0; i < node.count; ++i)
+            node.bounds.Grow(this->boxes[this->indices[node.leftFirst + i]]);
+    }
+
+    // Finds the cheapest binned SAH split. Returns false if keeping the
+    // node as a leaf is cheaper.
+    bool FindSplit(const BvhNode& node, int* splitAxis, float* splitPosition) const
+    {
+        Aabb<float> centroidBounds;
+        for (int i = 0; i < node.count; ++i)
+            centroidBounds.Grow(this->centroids[this->indices[node.leftFirst + i]]);
+
+        float bestCost = node.count * node.bounds.SurfaceArea();
+        bool isFound = false;
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const float lo = (&centroidBounds.min.x)[axis];
+            const float hi = (&centroidBounds.max.x)[axis];
+            if (hi <= lo)
+                continue;
+
+            Bin bins[BinCount];
+            for (int b = 0; b < BinCount; ++b)
+                bins[b].count = 0;
+
+            const float scale = BinCount / (hi - lo);
+            for (int i = 0; i < node.count; ++i)
+            {
+                const int primitive = this->indices[node.leftFirst + i];
+                const float c = (&this->centroids[primitive].x)[axis];
+                const int b = std::min(BinCount - 1, (int) ((c - lo) * scale));
+                bins[b].count++;
+                bins[b].bounds.Grow(this->boxes[primitive]);
+            }
+
+            // Sweep from both sides to get the cost of every plane
+            float leftArea[BinCount - 1], rightArea[BinCount - 1];
+            int leftCount[BinCount - 1], rightCount[BinCount - 1];
+            Aabb<float> left, right;
+            int leftSum = 0, rightSum = 0;
+            for (int b = 0; b < BinCount - 1; ++b)
+            {
+                leftSum += bins[b].count;
+                leftCount[b] = leftSum;
+                if (bins[b].count)
+                    left.Grow(bins[b].bounds);
+                leftArea[b] = left.IsEmpty() ? 0 : left.SurfaceArea();
+
+                const int r = BinCount - 1 - b;
+                rightSum += bins[r].count;
+                rightCount[r - 1] = rightSum;
+                if (bins[r].count)
+                    right.Grow(bins[r].bounds);
+                rightArea[r - 1] = right.IsEmpty() ? 0 : right.SurfaceArea();
+            }
+
+            for (int b = 0; b < BinCount - 1; ++b)
+            {
+                const float cost = leftCount[b] * leftArea[b] + rightCount[b] * rightArea[b];
+                if (leftCount[b] > 0 && rightCount[b] > 0 && cost < bestCost)
+                {
+                    bestCost = cost;
+                    *splitAxis = axis;
+                    *splitPosition = lo + (b + 1) / scale;
+                    isFound = true;
+                }
+            }
+        }
+
+        return isFound;
+    }
+
+    // Splits one node, returns false if it stays a leaf
+    bool Split(int nodeIndex)
+    {
+        BvhNode& node = this->nodes[nodeIndex];
+        if (node.count <= MaxLeafSize)
+            return false;
+
+        int axis = 0;
+        float position = 0;
+        if (!this->FindSplit(node, &axis, &position))
+            return false;
+
+        int i = node.leftFirst;
+        int j = i + node.count - 1;
+        while (i <= j)
+        {
+            if ((&this->centroids[this->indices[i]].x)[axis] < position)
+                i++;
+            else
+                std::swap(this->indices[i], this->indices[j--]);
+        }
+
+        const int leftCount = i - node.leftFirst;
+        if (leftCount == 0 || leftCount == node.count)
+            return false;
+
+        const int left = this->AllocateNodePair();
+        this->nodes[left].leftFirst = node.leftFirst;
+        this->nodes[left].count = leftCount;
+        this->nodes[left + 1].leftFirst = i;
+        this->nodes[left + 1].count = node.count - leftCount;
+        node.leftFirst = left;
+        node.count = 0;
+
+        this->UpdateBounds(left);
+        this->UpdateBounds(left + 1);
+
+        return true;
+    }
+
+    void Subdivide(int nodeIndex)
+    {
+        if (!this->Split(nodeIndex))
+            return;
+
+        const int left = this->nodes[nodeIndex].leftFirst;
+        this->Subdivide(left);
+        this->Subdivide(left + 1);
+    }
+
+    enum Containment
+    {
+        Outside,
+        Intersecting,
+        Inside
+    };
+
+    static Containment Classify(const Frustum<float>& frustum, const Aabb<float>& box)
+    {
+        Containment result = Inside;
+        for (int p = 0; p < Frustum<float>::PlaneCount; ++p)
+        {
+            const Plane<float>& plane = frustum.planes[p];
+            const Vec3<float> positive(plane.normal.x > 0 ? box.max.x : box.min.x,
+                                       plane.normal.y > 0 ? box.max.y : box.min.y,
+                                       plane.normal.z > 0 ? box.max.z : box.min.z);
+            if (plane.Distance(positive) < 0)
+                return Outside;
+
+            const Vec3<float> negative(plane.normal.x > 0 ? box.min.x : box.max.x,
+                                       plane.normal.y > 0 ? box.min.y : box.max.y,
+                                       plane.normal.z > 0 ? box.min.z : box.max.z);
+            if (plane.Distance(negative) < 0)
+                result = Intersecting;
+        }
+
+        return result;
+    }
+
+    // Slab test, returns the entry distance or a negative value on a miss
+    static float IntersectRay(const Aabb<float>& box, const Vec3<float>& origin,
+                              const Vec3<float>& inverseDirection, float tMax)
+    {
+        const float tx0 = (box.min.x - origin.x) * inverseDirection.x;
+        const float tx1 = (box.max.x - origin.x) * inverseDirection.x;
+        const float ty0 = (box.min.y - origin.y) * inverseDirection.y;
+        const float ty1 = (box.max.y - origin.y) * inverseDirection.y;
+        const float tz0 = (box.min.z - origin.z) * inverseDirection.z;
+        const float tz1 = (box.max.z - origin.z) * inverseDirection.z;
+
+        const float tNear = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::min(tz0, tz1));
+        const float tFar = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::max(tz0, tz1));
+        if (tFar < tNear || tFar < 0 || tNear > tMax)
+            return -1;
+
+        return std::max(tNear, 0.0f);
+    }
+
+    // Default primitive test for Raycast: the bounding box itself
+    struct BoxIntersector
+    {
+        const Bvh* bvh;
+
+        bool operator()(int primitive, const Vec3<float>& origin, const Vec3<float>& direction, float* t) const
+        {
+            const Vec3<float> inverseDirection(1 / direction.x, 1 / direction.y, 1 / direction.z);
+            const float hit = IntersectRay(this->bvh->boxes[primitive], origin, inverseDirection, *t);
+            if (hit < 0)
+                return false;
+
+            *t = hit;
+            return true;
+        }
+    };
+
+public:
+    Bvh()
+        : nodeCount(0)
+    {
+    }
+
+    inline int GetNodeCount() const { return this->nodeCount; }
+    inline const BvhNode* GetNodes() const { return this->nodes.data(); }
+
+    // boxes[i] is the bounding box of primitive (scene object) i
+    void Build(const Aabb<float>* boxes, int count)
+    {
+        this->boxes.assign(boxes, boxes + count);
+        this->centroids.resize(count);
+        this->indices.resize(count);
+        for (int i = 0; i < count; ++i)
+        {
+            this->centroids[i] = boxes[i].Center();
+            this->indices[i] = i;
+        }
+
+        this->nodes.resize(std::max(2 * count - 1, 1));
+        this->nodeCount = 1;
+        this->nodes[0].leftFirst = 0;
+        this->nodes[0].count = count;
+        this->UpdateBounds(0);
+        if (count == 0)
+            return;
+
+        if (count < ParallelThreshold)
+        {
+            this->Subdivide(0);
+            return;
+        }
+
+        // Split the top levels breadth first until there are enough
+        // independent subtrees, then finish those in parallel. Only the
+        // node allocation is shared between the threads.
+#ifdef _OPENMP
+        const int subtreeCount = omp_get_max_threads() * 4;
+#else
+        const int subtreeCount = 1;
+#endif
+        std::vector<int> subtrees(1, 0);
+        size_t next = 0;
+        while (next < subtrees.size() && (int) (subtrees.size() - next) < subtreeCount)
+        {
+            const int nodeIndex = subtrees[next++];
+            if (this->Split(nodeIndex))
+            {
+                subtrees.push_back(this->nodes[nodeIndex].leftFirst);
+                subtrees.push_back(this->nodes[nodeIndex].leftFirst + 1);
+            }
+        }
+
+        const int first = (int) next;
+        const int last = (int) subtrees.size();
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (int i = first; i < last; ++i)
+        {
+            const int nodeIndex = subtrees[i];
+            if (!this->nodes[nodeIndex].IsLeaf())
+                continue;
+            this->Subdivide(nodeIndex);
+        }
+    }
+
+    // Updates the bounds after primitives moved, keeping the topology.
+    // Much cheaper than a rebuild, but the tree degrades if objects move
+    // far from where they were at build time.
+    void Refit(const Aabb<float>* boxes)
+    {
+        const int count = (int) this->boxes.size();
+        for (int i = 0; i < count; ++i)
+        {
+            this->boxes[i] = boxes[i];
+            this->centroids[i] = boxes[i].Center();
+        }
+
+        for (int i = this->nodeCount - 1; i >= 0; --i)
+        {
+            BvhNode& node = this->nodes[i];
+            if (node.IsLeaf())
+            {
+                this->UpdateBounds(i);
+            }
+            else
+            {
+                node.bounds = this->nodes[node.leftFirst].bounds;
+                node.bounds.Grow(this->nodes[node.leftFirst + 1].bounds);
+            }
+        }
+    }
+
+    // Writes the ids of all primitives whose box intersects the frustum to
+    // visible (room for all primitives) and returns how many there are.
+    // Subtrees completely inside the frustum are accepted without tests.
+    int CullFrustum(const Frustum<float>& frustum, int* visible) const
+    {
+        if (this->boxes.empty())
+            return 0;
+
+        int stack[StackSize];
+        bool isInsideStack[StackSize];
+        int top = 0;
+        int visibleCount = 0;
+        stack[top] = 0;
+        isInsideStack[top++] = false;
+
+        while (top > 0)
+        {
+            --top;
+            const BvhNode& node = this->nodes[stack[top]];
+            bool isInside = isInsideStack[top];
+
+            if (!isInside)
+            {
+                const Containment containment = Classify(frustum, node.bounds);
+                if (containment == Outside)
+                    continue;
+                isInside = (containment == Inside);
+            }
+
+            if (node.IsLeaf())
+            {
+                for (int i = 0; i < node.count; ++i)
+                {
+                    const int primitive = this->indices[node.leftFirst + i];
+                    if (isInside || Classify(frustum, this->boxes[primitive]) != Outside)
+                        visible[visibleCount++] = primitive;
+                }
+            }
+            else
+            {
+                stack[top] = node.leftFirst;
+                isInsideStack[top++] = isInside;
+                stack[top] = node.leftFirst + 1;
+                isInsideStack[top++] = isInside;
+            }
+        }
+
+        return visibleCount;
+    }
+
+    // Writes the ids of all primitives whose box overlaps range to results
+    // (room for all primitives) and returns how many there are
+    int QueryRange(const Aabb<float>& range, int* results) const
+    {
+        if (this->boxes.empty())
+            return 0;
+
+        int stack[StackSize];
+        int top = 0;
+        int resultCount = 0;
+        stack[top++] = 0;
+
+        while (top > 0)
+        {
+            const BvhNode& node = this->nodes[stack[--top]];
+            if (!node.bounds.Overlaps(range))
+                continue;
+
+            if (node.IsLeaf())
+            {
+                for (int i = 0; i < node.count; ++i)
+                {
+                    const int primitive = this->indices[node.leftFirst + i];
+                    if (this->boxes[primitive].Overlaps(range))
+                        results[resultCount++] = primitive;
+                }
+            }
+            else
+            {
+                stack[top++] = node.leftFirst;
+                stack[top++] = node.leftFirst + 1;
+            }
+        }
+
+        return resultCount;
+    }
+
+    // Finds the nearest primitive along a ray. intersect(primitive, origin,
+    // direction, &t) gets t set to the current nearest distance and must
+    // return true and lower t for a closer hit. Children are visited near
+    // to far, so far subtrees are usually skipped entirely.
+    template<typename Intersector>
+    bool Raycast(const Vec3<float>& origin, const Vec3<float>& direction, Intersector intersect,
+                 int* hitPrimitive, float* hitDistance, float maxDistance = 1e30f) const
+    {
+        if (this->boxes.empty())
+            return false;
+
+        const Vec3<float> inverseDirection(1 / direction.x, 1 / direction.y, 1 / direction.z);
+        float nearest = maxDistance;
+        int hit = -1;
+
+        int stack[StackSize];
+        int top = 0;
+        stack[top++] = 0;
+
+        while (top > 0)
+        {
+            const BvhNode& node = this->nodes[stack[--top]];
+            if (IntersectRay(node.bounds, origin, inverseDirection, nearest) < 0)
+                continue;
+
+            if (node.IsLeaf())
+            {
+                for (int i = 0; i < node.count; ++i)
+                {
+                    const int primitive = this->indices[node.leftFirst + i];
+                    float t = nearest;
+                    if (intersect(primitive, origin, direction, &t) && t < nearest)
+                    {
+                        nearest = t;
+                        hit = primitive;
+                    }
+                }
+            }
+            else
+            {
+                // Push the far child first so the near one is popped next
+                const int left = node.leftFirst;
+                const float tLeft = IntersectRay(this->nodes[left].bounds, origin, inverseDirection, nearest);
+                const float tRight = IntersectRay(this->nodes[left + 1].bounds, origin, inverseDirection, nearest);
+                const bool isLeftNear = tLeft >= 0 && (tRight < 0 || tLeft <= tRight);
+                if (tLeft >= 0 || tRight >= 0)
+                {
+                    if (isLeftNear)
+                    {
+                        if (tRight >= 0)
+                            stack[top++] = left + 1;
+                        stack[top++] = left;
+                    }
+                    else
+                    {
+                        if (tLeft >= 0)
+                            stack[top++] = left;
+                        stack[top++] = left + 1;
+                    }
+                }
+            }
+        }
+
+        if (hit < 0)
+            return false;
+
+        *hitPrimitive = hit;
+        *hitDistance = nearest;
+        return true;
+    }
+
+    // Picks against the primitive bounding boxes
+    bool Raycast(const Vec3<float>& origin, const Vec3<float>& direction,
+                 int* hitPrimitive, float* hitDistance, float maxDistance = 1e30f) const
+    {
+        BoxIntersector intersect = { this };
+        return this->Raycast(origin, direction, intersect, hitPrimitive, hitDistance, maxDistance);
+    }
+};
\ No newline at end of file
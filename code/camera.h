@@ -0,0 +1,197 @@
+#pragma once
+#include "math/vec3.h"
+#include "math/mat4x4.h"
+#include "math/quat.h"
+#include "math/frustum.h"
+
+// Owns the view and projection of the scene. Derived matrices and the
+// frustum planes are cached and only recomputed after the camera changed,
+// so transform and culling stages can query them per object for free.
+class Camera
+{
+private:
+    Vec3<float>     position;
+    Quat<float>     orientation;
+
+    bool            isPerspective;
+    float           fovY;
+    float           aspect;
+    float           left, right, bottom, top;
+    float           zNear;
+    float           zFar;
+
+    mutable Mat4x4<float>   view;
+    mutable Mat4x4<float>   projection;
+    mutable Mat4x4<float>   viewProjection;
+    mutable Mat4x4<float>   inverseViewProjection;
+    mutable Frustum<float>  frustum;
+
+    mutable bool    isViewDirty;
+    mutable bool    isProjectionDirty;
+    mutable bool    isViewProjectionDirty;
+    mutable bool    isInverseDirty;
+    mutable bool    isFrustumDirty;
+
+    void InvalidateView()
+    {
+        this->isViewDirty = true;
+        this->InvalidateViewProjection();
+    }
+
+    void InvalidateProjection()
+    {
+        this->isProjectionDirty = true;
+        this->InvalidateViewProjection();
+    }
+
+    void InvalidateViewProjection()
+    {
+        this->isViewProjectionDirty = true;
+        this->isInverseDirty = true;
+        this->isFrustumDirty = true;
+    }
+
+public:
+    Camera()
+        : position(0, 0, 0), orientation(),
+          isPerspective(true), fovY(1.0471975f), aspect(4.0f / 3.0f),
+          left(-1), right(1), bottom(-1), top(1),
+          zNear(0.1f), zFar(1000.0f)
+    {
+        this->InvalidateView();
+        this->InvalidateProjection();
+    }
+
+    // fovY in radians
+    void SetPerspective(float fovY, float aspect, float zNear, float zFar)
+    {
+        this->isPerspective = true;
+        this->fovY = fovY;
+        this->aspect = aspect;
+        this->zNear = zNear;
+        this->zFar = zFar;
+        this->InvalidateProjection();
+    }
+
+    void SetOrthographic(float left, float right, float bottom, float top, float zNear, float zFar)
+    {
+        this->isPerspective = false;
+        this->left = left;
+        this->right = right;
+        this->bottom = bottom;
+        this->top = top;
+        this->zNear = zNear;
+        this->zFar = zFar;
+        this->InvalidateProjection();
+    }
+
+    void SetAspect(float aspect)
+    {
+        this->aspect = aspect;
+        this->InvalidateProjection();
+    }
+
+    void SetPosition(const Vec3<float>& position)
+    {
+        this->position = position;
+        this->InvalidateView();
+    }
+
+    // Rotation from camera space (looking down -z) to world space
+    void SetOrientation(const Quat<float>& orientation)
+    {
+        this->orientation = orientation.Normalized();
+        this->InvalidateView();
+    }
+
+    void LookAt(const Vec3<float>& target, const Vec3<float>& up = Vec3<float>(0, 1, 0))
+    {
+        const Mat4x4<float> lookAt = Mat4x4<float>::LookAt(this->position, target, up);
+
+        // The rotation part of a view matrix is the inverse camera rotation
+        this->orientation = Quat<float>::FromMat4x4(lookAt).Conjugate().Normalized();
+        this->InvalidateView();
+    }
+
+    void Move(const Vec3<float>& offset)
+    {
+        this->position += offset;
+        this->InvalidateView();
+    }
+
+    void Rotate(const Quat<float>& rotation)
+    {
+        this->orientation = (rotation * this->orientation).Normalized();
+        this->InvalidateView();
+    }
+
+    inline const Vec3<float>& GetPosition() const { return this->position; }
+    inline const Quat<float>& GetOrientation() const { return this->orientation; }
+
+    const Mat4x4<float>& GetView() const
+    {
+        if (this->isViewDirty)
+        {
+            // view = R^T * T(-position)
+            const Quat<float> inverse = this->orientation.Conjugate();
+            this->view = inverse.ToMat4x4();
+            const Vec3<float> translation = inverse.Rotate(-this->position);
+            this->view.m[3] = translation.x;
+            this->view.m[7] = translation.y;
+            this->view.m[11] = translation.z;
+            this->isViewDirty = false;
+        }
+
+        return this->view;
+    }
+
+    const Mat4x4<float>& GetProjection() const
+    {
+        if (this->isProjectionDirty)
+        {
+            if (this->isPerspective)
+                this->projection = Mat4x4<float>::Perspective(this->fovY, this->aspect, this->zNear, this->zFar);
+            else
+                this->projection = Mat4x4<float>::Orthographic(this->left, this->right, this->bottom, this->top,
+                                                               this->zNear, this->zFar);
+            this->isProjectionDirty = false;
+        }
+
+        return this->projection;
+    }
+
+    const Mat4x4<float>& GetViewProjection() const
+    {
+        if (this->isViewProjectionDirty)
+        {
+            this->viewProjection = this->GetProjection() * this->GetView();
+            this->isViewProjectionDirty = false;
+        }
+
+        return this->viewProjection;
+    }
+
+    // Maps clip space back to world space, e.g. for picking rays
+    const Mat4x4<float>& GetInverseViewProjection() const
+    {
+        if (this->isInverseDirty)
+        {
+            this->inverseViewProjection = this->GetViewProjection().Inverted();
+            this->isInverseDirty = false;
+        }
+
+        return this->inverseViewProjection;
+    }
+
+    // World space planes, normals pointing inward
+    const Frustum<float>& GetFrustum() const
+    {
+        if (this->isFrustumDirty)
+        {
+            this->frustum = Frustum<float>::FromMatrix(this->GetViewProjection());
+            this->isFrustumDirty = false;
+        }
+
+        return this->frustum;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,222 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include "clip.h"
+#include "kernels.h"
+
+// Second order midpoint circle, one octant: the y of every x from 0 up to
+// where x passes y. ys[0] is the radius and ys never increases.
+inline void CircleOctant(const int radius, std::vector<int>* ys)
+{
+    ys->clear();
+    int d = 1 - radius;
+    int y = radius;
+    int deltaE = 3;
+    int deltaSE = 5 - radius * 2;
+    
+    for (int x = 0; x <= y; ++x)
+    {
+        ys->push_back(y);
+        if (d < 0)
+        {
+            // Select E
+            d += deltaE;
+            deltaE += 2;
+            deltaSE += 2;
+        }
+        else
+        {
+            // Select SE
+            d += deltaSE;
+            deltaE += 2;
+            deltaSE += 4;
+            y--;
+        }
+    }
+}
+
+// Half widths of the rows 0 to radius away from the center of a filled
+// circle, taken from the octant so the fill covers exactly its outline
+inline void CircleSpans(const std::vector<int>& ys, std::vector<int>* halfWidths)
+{
+    halfWidths->assign(ys[0] + 1, 0);
+    for (int x = 0; x < (int) ys.size(); ++x)
+    {
+        (*halfWidths)[ys[x]] = std::max((*halfWidths)[ys[x]], x);
+        (*halfWidths)[x] = std::max((*halfWidths)[x], ys[x]);
+    }
+}
+
+// Same for base + sign * ys[i]. ys is sorted high to low, so the steps
+// that pass are one range as well, found by binary search.
+inline void ClipOctantValues(const std::vector<int>& ys, const int base, const int sign,
+                             const int low, const int high, int* begin, int* end)
+{
+    const int minValue = sign > 0 ? low - base : base - high;
+    const int maxValue = sign > 0 ? high - base : base - low;
+    const int* first = ys.data();
+    const int* last = first + ys.size();
+    *begin = std::max(*begin, (int) (std::lower_bound(first, last, maxValue, std::greater<int>()) - first));
+    *end = std::min(*end, (int) (std::upper_bound(first, last, minValue, std::greater<int>()) - first));
+}
+
+// Outline of the circle around (xMid, yMid) in backbuffer coordinates from
+// its octant (see CircleOctant). Every octant is clipped to one range of
+// steps up front, the writes themselves are unchecked. Circles fully
+// inside the clip rect skip the clipping altogether.
+inline void DrawCircleOctants(unsigned char* pixels, const int pitch, const ClipRect& clip,
+                              const int xMid, const int yMid, const std::vector<int>& ys,
+                              const unsigned int value)
+{
+    const int radius = ys[0];
+    if (!clip.Intersects(xMid - radius, yMid - radius, xMid + radius, yMid + radius))
+        return;
+    
+    const bool inside = clip.Contains(xMid - radius, yMid - radius, xMid + radius, yMid + radius);
+    const int count = (int) ys.size();
+    static const int signs[4][2] = { { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+    
+    for (int octant = 0; octant < 8; ++octant)
+    {
+        // Even octants step x and look up y, odd ones the other way around
+        const bool swapped = (octant & 1) != 0;
+        const int sx = signs[octant >> 1][0];
+        const int sy = signs[octant >> 1][1];
+        
+        int begin = 0;
+        int end = count;
+        if (!inside)
+        {
+            if (swapped)
+            {
+                ClipOctantValues(ys, xMid, sx, clip.minX, clip.maxX, &begin, &end);
+                ClipSteps(yMid, sy, clip.minY, clip.maxY, &begin, &end);
+            }
+            else
+            {
+                ClipSteps(xMid, sx, clip.minX, clip.maxX, &begin, &end);
+                ClipOctantValues(ys, yMid, sy, clip.minY, clip.maxY, &begin, &end);
+            }
+        }
+        
+        if (swapped)
+        {
+            for (int i = begin; i < end; ++i)
+                ((unsigned int*) (pixels + (yMid + sy * i) * pitch))[xMid + sx * ys[i]] = value;
+        }
+        else
+        {
+            for (int i = begin; i < end; ++i)
+                ((unsigned int*) (pixels + (yMid + sy * ys[i]) * pitch))[xMid + sx * i] = value;
+        }
+    }
+}
+
+// Clipped horizontal spans of a filled circle (see CircleSpans) through the
+// span kernels. Blend modes other than Opaque read the premultiplied color
+// from source, at least radius * 2 + 1 copies of value.
+inline void FillCircleRows(unsigned char* pixels, const int pitch, const ClipRect& clip,
+                           const int xMid, const int yMid, const std::vector<int>& halfWidths,
+                           const unsigned int value, const BlendMode mode, const unsigned int* source)
+{
+    const int radius = (int) halfWidths.size() - 1;
+    const Kernels& kernels = GetKernels();
+    const int yBegin = std::max(yMid - radius, clip.minY);
+    const int yEnd = std::min(yMid + radius, clip.maxY);
+    
+    for (int row = yBegin; row <= yEnd; ++row)
+    {
+        const int halfWidth = halfWidths[std::abs(row - yMid)];
+        const int xBegin = std::max(xMid - halfWidth, clip.minX);
+        const int xEnd = std::min(xMid + halfWidth, clip.maxX) + 1;
+        if (xBegin >= xEnd)
+            continue;
+        
+        unsigned int* span = (unsigned int*) (pixels + row * pitch) + xBegin;
+        if (mode == BlendMode::Opaque)
+            kernels.fillSpan(span, xEnd - xBegin, value);
+        else
+            kernels.blendSpan[(int) mode](span, source, xEnd - xBegin);
+    }
+}
+
+// Octant and row spans of one radius
+struct CircleShape
+{
+    std::vector<int> steps;
+    std::vector<int> halfWidths;
+};
+
+// Whether the outline of a circle can have a pixel inside clip: the rect
+// has to reach from inside the radius to outside of it, with a pixel of
+// slack for the rounding of the midpoint steps
+inline bool CircleOutlineIntersects(const ClipRect& clip, const int xMid, const int yMid, const int radius)
+{
+    const double dxMin = (double) clip.minX - xMid, dxMax = (double) clip.maxX - xMid;
+    const double dyMin = (double) clip.minY - yMid, dyMax = (double) clip.maxY - yMid;
+    const double nearX = std::max(std::max(dxMin, -dxMax), 0.0);
+    const double nearY = std::max(std::max(dyMin, -dyMax), 0.0);
+    const double farX = std::max(-dxMin, dxMax);
+    const double farY = std::max(-dyMin, dyMax);
+    const double outer = radius + 1.0, inner = std::max(radius - 1.0, 0.0);
+    return nearX * nearX + nearY * nearY <= outer * outer && farX * farX + farY * farY >= inner * inner;
+}
+
+// Circle shapes by radius, built on first use. Shapes not used since the
+// previous Evict (once a frame) are dropped, so only the radii being drawn
+// take memory.
+class CircleCache
+{
+private:
+    struct Entry
+    {
+        CircleShape shape;
+        bool        used;
+    };
+    
+    std::unordered_map<int, Entry> entries;
+    
+public:
+    // Builds the shape if needed. Shapes do not move, references to them
+    // stay valid until Evict or Clear.
+    const CircleShape& Get(const int radius)
+    {
+        Entry& entry = this->entries[radius];
+        entry.used = true;
+        if (entry.shape.steps.empty())
+        {
+            CircleOctant(radius, &entry.shape.steps);
+            CircleSpans(entry.shape.steps, &entry.shape.halfWidths);
+        }
+        return entry.shape;
+    }
+    
+    // Only for radii already built by Get, safe to share between threads
+    inline const CircleShape& operator[](const int radius) const
+    {
+        return this->entries.find(radius)->second.shape;
+    }
+    
+    void Evict()
+    {
+        for (std::unordered_map<int, Entry>::iterator it = this->entries.begin(); it != this->entries.end(); )
+        {
+            if (!it->second.used)
+            {
+                it = this->entries.erase(it);
+            }
+            else
+            {
+                it->second.used = false;
+                ++it;
+            }
+        }
+    }
+    
+    void Clear()
+    {
+        this->entries.clear();
+    }
+};
\ No newline at end of file
@@ -0,0 +1,100 @@
+#pragma once
+#include <cmath>
+#include <algorithm>
+#include "math/line.h"
+
+// Inclusive pixel bounds in backbuffer coordinates (y down)
+struct ClipRect
+{
+    int minX;
+    int minY;
+    int maxX;
+    int maxY;
+    
+    bool IsEmpty() const
+    {
+        return this->minX > this->maxX || this->minY > this->maxY;
+    }
+    
+    // Whether the box is entirely inside, so nothing in it needs clipping
+    bool Contains(const int x0, const int y0, const int x1, const int y1) const
+    {
+        return x0 >= this->minX && y0 >= this->minY && x1 <= this->maxX && y1 <= this->maxY;
+    }
+    
+    bool Intersects(const int x0, const int y0, const int x1, const int y1) const
+    {
+        return x0 <= this->maxX && y0 <= this->maxY && x1 >= this->minX && y1 >= this->minY;
+    }
+};
+
+// Narrows [*begin, *end) to the steps i for which base + sign * i is in
+// [low, high]
+inline void ClipSteps(const int base, const int sign, const int low, const int high, int* begin, int* end)
+{
+    *begin = std::max(*begin, sign > 0 ? low - base : base - high);
+    *end = std::min(*end, (sign > 0 ? high - base : base - low) + 1);
+}
+
+// Cohen-Sutherland outcode of a point against rect
+inline int Outcode(const ClipRect& rect, const int x, const int y)
+{
+    return (x < rect.minX ? 1 : 0) | (x > rect.maxX ? 2 : 0) | (y < rect.minY ? 4 : 0) | (y > rect.maxY ? 8 : 0);
+}
+
+// Cohen-Sutherland: cuts the line at the rect edges it crosses until both
+// ends are inside (accepted) or both outside of one edge (rejected).
+// Intersections are rounded to the nearest pixel.
+inline ClippedLine ClipLine(const Line& line, const ClipRect& rect)
+{
+    int x0 = line.x0, y0 = line.y0, x1 = line.x1, y1 = line.y1;
+    int code0 = Outcode(rect, x0, y0);
+    int code1 = Outcode(rect, x1, y1);
+    
+    for (;;)
+    {
+        if ((code0 | code1) == 0)
+            return ClippedLine(Line(x0, y0, x1, y1), true);
+        if ((code0 & code1) != 0)
+            return ClippedLine(line, false);
+        
+        // Move an outside end onto the edge it is beyond. Intersections are
+        // taken from the original line, so rounding does not add up.
+        const int code = code0 ? code0 : code1;
+        const double dx = (double) line.x1 - line.x0, dy = (double) line.y1 - line.y0;
+        int x, y;
+        if (code & 8)
+        {
+            y = rect.maxY;
+            x = line.x0 + (int) floor(dx * (y - line.y0) / dy + 0.5);
+        }
+        else if (code & 4)
+        {
+            y = rect.minY;
+            x = line.x0 + (int) floor(dx * (y - line.y0) / dy + 0.5);
+        }
+        else if (code & 2)
+        {
+            x = rect.maxX;
+            y = line.y0 + (int) floor(dy * (x - line.x0) / dx + 0.5);
+        }
+        else
+        {
+            x = rect.minX;
+            y = line.y0 + (int) floor(dy * (x - line.x0) / dx + 0.5);
+        }
+        
+        if (code == code0)
+        {
+            x0 = x;
+            y0 = y;
+            code0 = Outcode(rect, x0, y0);
+        }
+        else
+        {
+            x1 = x;
+            y1 = y;
+            code1 = Outcode(rect, x1, y1);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+#pragma once
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+// Kernels for a newer ISA than the baseline are compiled per function.
+// MSVC allows every intrinsic anywhere, GCC and Clang need a target
+// attribute. Visual Studio 2015 has no AVX-512 intrinsics at all. GCC
+// would also fuse separate multiplies and adds into FMA, which rounds
+// differently from the SSE2 kernels, so contraction is off for them.
+// Clang only fuses within one expression.
+#if defined(_MSC_VER)
+#define TARGET_AVX2
+#define TARGET_AVX512
+#if _MSC_VER >= 1910
+#define HAS_AVX512_INTRINSICS
+#endif
+#elif defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx2,fma,avx512f,avx512bw")))
+#define HAS_AVX512_INTRINSICS
+#else
+#define TARGET_AVX2 __attribute__((target("avx2,fma"), optimize("fp-contract=off")))
+#define TARGET_AVX512 __attribute__((target("avx2,fma,avx512f,avx512bw"), optimize("fp-contract=off")))
+#define HAS_AVX512_INTRINSICS
+#endif
+
+enum class Isa
+{
+    Sse2,
+    Avx2,       // With FMA
+    Avx512,     // F and BW
+};
+
+inline void Cpuid(const int leaf, const int subleaf, int registers[4])
+{
+#if defined(_MSC_VER)
+    __cpuidex(registers, leaf, subleaf);
+#else
+    unsigned int a, b, c, d;
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+    registers[0] = (int) a;
+    registers[1] = (int) b;
+    registers[2] = (int) c;
+    registers[3] = (int) d;
+#endif
+}
+
+// XCR0: which register states the OS saves on a context switch
+inline unsigned long long ReadXcr0()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long) edx << 32) | eax;
+#endif
+}
+
+// Best ISA the CPU and the OS support. The instructions alone are not
+// enough, an OS that does not save YMM/ZMM registers makes them unusable.
+inline Isa DetectIsa()
+{
+    int registers[4];
+    Cpuid(0, 0, registers);
+    const int maxLeaf = registers[0];
+    if (maxLeaf < 7)
+        return Isa::Sse2;
+
+    Cpuid(1, 0, registers);
+    const bool hasOsXsave = (registers[2] & (1 << 27)) != 0;
+    const bool hasAvx = (registers[2] & (1 << 28)) != 0;
+    const bool hasFma = (registers[2] & (1 << 12)) != 0;
+    if (!hasOsXsave || !hasAvx || !hasFma)
+        return Isa::Sse2;
+
+    const unsigned long long xcr0 = ReadXcr0();
+    const bool savesYmm = (xcr0 & 0x06) == 0x06;
+    const bool savesZmm = (xcr0 & 0xE6) == 0xE6;
+
+    Cpuid(7, 0, registers);
+    const bool hasAvx2 = (registers[1] & (1 << 5)) != 0;
+    const bool hasAvx512F = (registers[1] & (1 << 16)) != 0;
+    const bool hasAvx512BW = (registers[1] & (1 << 30)) != 0;
+
+#if defined(HAS_AVX512_INTRINSICS)
+    if (savesZmm && hasAvx2 && hasAvx512F && hasAvx512BW)
+        return Isa::Avx512;
+#else
+    (void) savesZmm;
+    (void) hasAvx512F;
+    (void) hasAvx512BW;
+#endif
+    if (savesYmm && hasAvx2)
+        return Isa::Avx2;
+    return Isa::Sse2;
+}
+
+inline const char* GetIsaName(const Isa isa)
+{
+    switch (isa)
+    {
+        case Isa::Avx512: return "AVX-512";
+        case Isa::Avx2: return "AVX2";
+        default: return "SSE2";
+    }
+}
\ No newline at end of file
@@ -0,0 +1,272 @@
+#pragma once
+#include <vector>
+#include <emmintrin.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+#include "math/vec3.h"
+#include "math/aabb.h"
+#include "math/frustum.h"
+
+// Bounding volumes of the scene objects in SoA layout, so the culling
+// kernels can load the same component of several objects at once.
+// The position of a volume is the index that ends up in the visible list.
+struct SphereBounds
+{
+    std::vector<float> x, y, z, radius;
+
+    inline int Count() const { return (int) this->x.size(); }
+
+    void Add(const Vec3<float>& center, float radius)
+    {
+        this->x.push_back(center.x);
+        this->y.push_back(center.y);
+        this->z.push_back(center.z);
+        this->radius.push_back(radius);
+    }
+
+    void Set(int index, const Vec3<float>& center, float radius)
+    {
+        this->x[index] = center.x;
+        this->y[index] = center.y;
+        this->z[index] = center.z;
+        this->radius[index] = radius;
+    }
+
+    void Clear()
+    {
+        this->x.clear();
+        this->y.clear();
+        this->z.clear();
+        this->radius.clear();
+    }
+};
+
+struct BoxBounds
+{
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+    inline int Count() const { return (int) this->minX.size(); }
+
+    void Add(const Aabb<float>& box)
+    {
+        this->minX.push_back(box.min.x);
+        this->minY.push_back(box.min.y);
+        this->minZ.push_back(box.min.z);
+        this->maxX.push_back(box.max.x);
+        this->maxY.push_back(box.max.y);
+        this->maxZ.push_back(box.max.z);
+    }
+
+    void Set(int index, const Aabb<float>& box)
+    {
+        this->minX[index] = box.min.x;
+        this->minY[index] = box.min.y;
+        this->minZ[index] = box.min.z;
+        this->maxX[index] = box.max.x;
+        this->maxY[index] = box.max.y;
+        this->maxZ[index] = box.max.z;
+    }
+
+    void Clear()
+    {
+        this->minX.clear();
+        this->minY.clear();
+        this->minZ.clear();
+        this->maxX.clear();
+        this->maxY.clear();
+        this->maxZ.clear();
+    }
+};
+
+// Appends the indices of the set bits of an 8 bit mask. Always writes a
+// slot and only advances on set bits, so there is no branch per object.
+inline int CompactVisible(int mask, const int base, int* visible, int count)
+{
+    for (int k = 0; k < 8; ++k)
+    {
+        visible[count] = base + k;
+        count += (mask >> k) & 1;
+    }
+
+    return count;
+}
+
+// A sphere is culled if it is completely behind one plane
+inline bool IsSphereVisible(const Frustum<float>& frustum, float x, float y, float z, float radius)
+{
+    return frustum.IntersectsSphere(Vec3<float>(x, y, z), radius);
+}
+
+// A box is culled if its corner farthest along a plane normal (the
+// positive vertex) is behind that plane
+inline bool IsBoxVisible(const Frustum<float>& frustum,
+                         float minX, float minY, float minZ,
+                         float maxX, float maxY, float maxZ)
+{
+    for (int p = 0; p < Frustum<float>::PlaneCount; ++p)
+    {
+        const Plane<float>& plane = frustum.planes[p];
+        const float x = plane.normal.x > 0 ? maxX : minX;
+        const float y = plane.normal.y > 0 ? maxY : minY;
+        const float z = plane.normal.z > 0 ? maxZ : minZ;
+        if (plane.normal.x * x + plane.normal.y * y + plane.normal.z * z + plane.d < 0)
+            return false;
+    }
+
+    return true;
+}
+
+// Writes the indices of all spheres intersecting the frustum to visible
+// (room for spheres.Count() entries) and returns how many there are.
+// Tests 8 spheres per iteration: one AVX register when the build enables
+// AVX, two SSE registers otherwise.
+inline int CullSpheres(const Frustum<float>& frustum, const SphereBounds& spheres, int* visible)
+{
+    const int count = spheres.Count();
+    const float* xs = spheres.x.data();
+    const float* ys = spheres.y.data();
+    const float* zs = spheres.z.data();
+    const float* rs = spheres.radius.data();
+    int visibleCount = 0;
+    int i = 0;
+
+#if defined(__AVX__)
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(xs + i);
+        const __m256 y = _mm256_loadu_ps(ys + i);
+        const __m256 z = _mm256_loadu_ps(zs + i);
+        const __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(rs + i));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+        for (int p = 0; p < Frustum<float>::PlaneCount; ++p)
+        {
+            const Plane<float>& plane = frustum.planes[p];
+            const __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.normal.x)),
+                              _mm256_mul_ps(y, _mm256_set1_ps(plane.normal.y))),
+                _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(plane.normal.z)),
+                              _mm256_set1_ps(plane.d)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+        }
+
+        visibleCount = CompactVisible(_mm256_movemask_ps(inside), i, visible, visibleCount);
+    }
+#else
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128 x0 = _mm_loadu_ps(xs + i), x1 = _mm_loadu_ps(xs + i + 4);
+        const __m128 y0 = _mm_loadu_ps(ys + i), y1 = _mm_loadu_ps(ys + i + 4);
+        const __m128 z0 = _mm_loadu_ps(zs + i), z1 = _mm_loadu_ps(zs + i + 4);
+        const __m128 r0 = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(rs + i));
+        const __m128 r1 = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(rs + i + 4));
+        __m128 inside0 = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        __m128 inside1 = inside0;
+
+        for (int p = 0; p < Frustum<float>::PlaneCount; ++p)
+        {
+            const Plane<float>& plane = frustum.planes[p];
+            const __m128 nx = _mm_set1_ps(plane.normal.x);
+            const __m128 ny = _mm_set1_ps(plane.normal.y);
+            const __m128 nz = _mm_set1_ps(plane.normal.z);
+            const __m128 d = _mm_set1_ps(plane.d);
+
+            const __m128 distance0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x0, nx), _mm_mul_ps(y0, ny)),
+                                                _mm_add_ps(_mm_mul_ps(z0, nz), d));
+            const __m128 distance1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x1, nx), _mm_mul_ps(y1, ny)),
+                                                _mm_add_ps(_mm_mul_ps(z1, nz), d));
+            inside0 = _mm_and_ps(inside0, _mm_cmpge_ps(distance0, r0));
+            inside1 = _mm_and_ps(inside1, _mm_cmpge_ps(distance1, r1));
+        }
+
+        const int mask = _mm_movemask_ps(inside0) | (_mm_movemask_ps(inside1) << 4);
+        visibleCount = CompactVisible(mask, i, visible, visibleCount);
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        if (IsSphereVisible(frustum, xs[i], ys[i], zs[i], rs[i]))
+            visible[visibleCount++] = i;
+    }
+
+    return visibleCount;
+}
+
+// Same as CullSpheres for boxes. The positive vertex of a box depends only
+// on the signs of the plane normal, which are the same for all 8 boxes, so
+// it is picked per plane instead of per lane.
+inline int CullBoxes(const Frustum<float>& frustum, const BoxBounds& boxes, int* visible)
+{
+    const int count = boxes.Count();
+    const float* mins[3] = { boxes.minX.data(), boxes.minY.data(), boxes.minZ.data() };
+    const float* maxs[3] = { boxes.maxX.data(), boxes.maxY.data(), boxes.maxZ.data() };
+    const float* positive[Frustum<float>::PlaneCount][3];
+    for (int p = 0; p < Frustum<float>::PlaneCount; ++p)
+    {
+        const Vec3<float>& n = frustum.planes[p].normal;
+        positive[p][0] = n.x > 0 ? maxs[0] : mins[0];
+        positive[p][1] = n.y > 0 ? maxs[1] : mins[1];
+        positive[p][2] = n.z > 0 ? maxs[2] : mins[2];
+    }
+
+    int visibleCount = 0;
+    int i = 0;
+
+#if defined(__AVX__)
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < Frustum<float>::PlaneCount; ++p)
+        {
+            const Plane<float>& plane = frustum.planes[p];
+            const __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(positive[p][0] + i), _mm256_set1_ps(plane.normal.x)),
+                              _mm256_mul_ps(_mm256_loadu_ps(positive[p][1] + i), _mm256_set1_ps(plane.normal.y))),
+                _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(positive[p][2] + i), _mm256_set1_ps(plane.normal.z)),
+                              _mm256_set1_ps(plane.d)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+
+        visibleCount = CompactVisible(_mm256_movemask_ps(inside), i, visible, visibleCount);
+    }
+#else
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128 inside0 = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        __m128 inside1 = inside0;
+        for (int p = 0; p < Frustum<float>::PlaneCount; ++p)
+        {
+            const Plane<float>& plane = frustum.planes[p];
+            const __m128 nx = _mm_set1_ps(plane.normal.x);
+            const __m128 ny = _mm_set1_ps(plane.normal.y);
+            const __m128 nz = _mm_set1_ps(plane.normal.z);
+            const __m128 d = _mm_set1_ps(plane.d);
+            const float* px = positive[p][0] + i;
+            const float* py = positive[p][1] + i;
+            const float* pz = positive[p][2] + i;
+
+            const __m128 distance0 = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(px), nx), _mm_mul_ps(_mm_loadu_ps(py), ny)),
+                _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pz), nz), d));
+            const __m128 distance1 = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(px + 4), nx), _mm_mul_ps(_mm_loadu_ps(py + 4), ny)),
+                _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pz + 4), nz), d));
+            inside0 = _mm_and_ps(inside0, _mm_cmpge_ps(distance0, _mm_setzero_ps()));
+            inside1 = _mm_and_ps(inside1, _mm_cmpge_ps(distance1, _mm_setzero_ps()));
+        }
+
+        const int mask = _mm_movemask_ps(inside0) | (_mm_movemask_ps(inside1) << 4);
+        visibleCount = CompactVisible(mask, i, visible, visibleCount);
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        if (IsBoxVisible(frustum, mins[0][i], mins[1][i], mins[2][i], maxs[0][i], maxs[1][i], maxs[2][i]))
+            visible[visibleCount++] = i;
+    }
+
+    return visibleCount;
+}
\ No newline at end of file
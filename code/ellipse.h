@@ -0,0 +1,306 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include "clip.h"
+#include "circle.h"
+#include "kernels.h"
+
+// Second order midpoint ellipse, one quadrant from (0, radiusY) to
+// (radiusX, 0). xs never decreases and ys never increases. Everything is
+// scaled by 4 to stay in integers, 64 bit since the terms grow with
+// radiusX^2 * radiusY^2.
+inline void EllipseQuadrant(const int radiusX, const int radiusY, std::vector<int>* xs, std::vector<int>* ys)
+{
+    xs->clear();
+    ys->clear();
+    if (radiusY == 0)
+    {
+        for (int x = 0; x <= radiusX; ++x)
+        {
+            xs->push_back(x);
+            ys->push_back(0);
+        }
+        return;
+    }
+    
+    const long long a2 = (long long) radiusX * radiusX;
+    const long long b2 = (long long) radiusY * radiusY;
+    int x = 0;
+    int y = radiusY;
+    
+    // Region 1, the slope is above -1: step E or SE
+    long long d = 4 * b2 - 4 * a2 * radiusY + a2;
+    long long deltaE = 12 * b2;                 // 4 * b2 * (2x + 3)
+    long long deltaS = 4 * a2 * (2 - 2 * y);    // 4 * a2 * (2 - 2y)
+    while (b2 * x < a2 * y)
+    {
+        xs->push_back(x);
+        ys->push_back(y);
+        if (d < 0)
+        {
+            // Select E
+            d += deltaE;
+        }
+        else
+        {
+            // Select SE
+            d += deltaE + deltaS;
+            deltaS += 8 * a2;
+            y--;
+        }
+        deltaE += 8 * b2;
+        x++;
+    }
+    
+    // Region 2, the slope is below -1: step S or SE
+    d = b2 * (2 * x + 1) * (2 * x + 1) + 4 * a2 * (y - 1) * (y - 1) - 4 * a2 * b2;
+    deltaS = 4 * a2 * (3 - 2 * y);              // 4 * a2 * (3 - 2y)
+    deltaE = 4 * b2 * (2 * x + 2);              // 4 * b2 * (2x + 2)
+    while (y >= 0)
+    {
+        xs->push_back(x);
+        ys->push_back(y);
+        if (d > 0)
+        {
+            // Select S
+            d += deltaS;
+        }
+        else
+        {
+            // Select SE
+            d += deltaE + deltaS;
+            deltaE += 8 * b2;
+            x++;
+        }
+        deltaS += 8 * a2;
+        y--;
+    }
+    
+    // Very flat ellipses leave region 2 before reaching the tip
+    for (x = xs->back() + 1; x <= radiusX; ++x)
+    {
+        xs->push_back(x);
+        ys->push_back(0);
+    }
+}
+
+// Half widths of the rows 0 to radiusY away from the center of a filled
+// ellipse, covering exactly its outline
+inline void EllipseSpans(const std::vector<int>& xs, const std::vector<int>& ys, std::vector<int>* halfWidths)
+{
+    halfWidths->assign(ys[0] + 1, 0);
+    for (int i = 0; i < (int) xs.size(); ++i)
+        (*halfWidths)[ys[i]] = std::max((*halfWidths)[ys[i]], xs[i]);
+}
+
+// Narrows [*begin, *end) to the steps i for which base + sign * xs[i] is
+// in [low, high], xs sorted low to high
+inline void ClipQuadrantValues(const std::vector<int>& xs, const int base, const int sign,
+                               const int low, const int high, int* begin, int* end)
+{
+    const int minValue = sign > 0 ? low - base : base - high;
+    const int maxValue = sign > 0 ? high - base : base - low;
+    const int* first = xs.data();
+    const int* last = first + xs.size();
+    *begin = std::max(*begin, (int) (std::lower_bound(first, last, minValue) - first));
+    *end = std::min(*end, (int) (std::upper_bound(first, last, maxValue) - first));
+}
+
+// Outline of the ellipse around (xMid, yMid) in backbuffer coordinates
+// from its quadrant, like DrawCircleOctants: clipped to one range per
+// quadrant, then written unchecked
+inline void DrawEllipseQuadrants(unsigned char* pixels, const int pitch, const ClipRect& clip,
+                                 const int xMid, const int yMid,
+                                 const std::vector<int>& xs, const std::vector<int>& ys,
+                                 const unsigned int value)
+{
+    const int radiusX = xs.back();
+    const int radiusY = ys[0];
+    if (!clip.Intersects(xMid - radiusX, yMid - radiusY, xMid + radiusX, yMid + radiusY))
+        return;
+    
+    const bool inside = clip.Contains(xMid - radiusX, yMid - radiusY, xMid + radiusX, yMid + radiusY);
+    static const int signs[4][2] = { { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+    
+    for (int quadrant = 0; quadrant < 4; ++quadrant)
+    {
+        const int sx = signs[quadrant][0];
+        const int sy = signs[quadrant][1];
+        int begin = 0;
+        int end = (int) xs.size();
+        if (!inside)
+        {
+            ClipQuadrantValues(xs, xMid, sx, clip.minX, clip.maxX, &begin, &end);
+            ClipOctantValues(ys, yMid, sy, clip.minY, clip.maxY, &begin, &end);
+        }
+        
+        for (int i = begin; i < end; ++i)
+            ((unsigned int*) (pixels + (yMid + sy * ys[i]) * pitch))[xMid + sx * xs[i]] = value;
+    }
+}
+
+// Part of the outline whose direction from the center lies between the
+// angles start and end, in radians counter-clockwise from +x with y up
+// (the renderer's convention). Going from start to end counter-clockwise,
+// so start > end wraps around.
+inline void DrawEllipseArc(unsigned char* pixels, const int pitch, const ClipRect& clip,
+                           const int xMid, const int yMid,
+                           const std::vector<int>& xs, const std::vector<int>& ys,
+                           const float start, const float end, const unsigned int value)
+{
+    const int radiusX = xs.back();
+    const int radiusY = ys[0];
+    if (!clip.Intersects(xMid - radiusX, yMid - radiusY, xMid + radiusX, yMid + radiusY))
+        return;
+    
+    const float twoPi = 6.28318531f;
+    float sweep = twoPi;
+    if (end - start < twoPi)
+    {
+        sweep = fmodf(end - start, twoPi);
+        if (sweep < 0)
+            sweep += twoPi;
+    }
+    const float startX = cosf(start), startY = sinf(start);
+    const float endX = cosf(start + sweep), endY = sinf(start + sweep);
+    const bool convex = sweep <= twoPi * 0.5f;
+    static const int signs[4][2] = { { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+    
+    for (int quadrant = 0; quadrant < 4; ++quadrant)
+    {
+        const int sx = signs[quadrant][0];
+        const int sy = signs[quadrant][1];
+        int begin = 0;
+        int last = (int) xs.size();
+        ClipQuadrantValues(xs, xMid, sx, clip.minX, clip.maxX, &begin, &last);
+        ClipOctantValues(ys, yMid, sy, clip.minY, clip.maxY, &begin, &last);
+        
+        for (int i = begin; i < last; ++i)
+        {
+            // Backbuffer y is down, the angles are y up
+            const float px = (float) (sx * xs[i]);
+            const float py = (float) (-sy * ys[i]);
+            const float fromStart = startX * py - startY * px;
+            const float toEnd = px * endY - py * endX;
+            const bool inArc = convex ? (fromStart >= 0 && toEnd >= 0) : (fromStart >= 0 || toEnd >= 0);
+            if (inArc)
+                ((unsigned int*) (pixels + (yMid + sy * ys[i]) * pitch))[xMid + sx * xs[i]] = value;
+        }
+    }
+}
+
+// Row spans of an ellipse rotated counter-clockwise (y up) by angle around
+// its center. Row i is i - extent rows below the center, lefts[i] and
+// rights[i] are inclusive offsets from the center, empty when left > right.
+// Per row it solves A x^2 + B x y + C y^2 = D for x; the discriminant is
+// quadratic in y and stepped with second order differences.
+inline int RotatedEllipseSpans(const int radiusX, const int radiusY, const float angle,
+                               std::vector<int>* lefts, std::vector<int>* rights)
+{
+    const double c = cos(angle), s = sin(angle);
+    const double a2 = (double) radiusX * radiusX;
+    const double b2 = (double) radiusY * radiusY;
+    const double A = b2 * c * c + a2 * s * s;
+    const double B = 2 * c * s * (b2 - a2);
+    const double C = b2 * s * s + a2 * c * c;
+    const double D = a2 * b2;
+    const int extent = (int) sqrt(a2 * s * s + b2 * c * c);
+    lefts->resize(extent * 2 + 1);
+    rights->resize(extent * 2 + 1);
+    
+    if (A <= 0)
+    {
+        // Both radii are 0
+        (*lefts)[0] = (*rights)[0] = 0;
+        return extent;
+    }
+    
+    // y up, so row i is at y = extent - i
+    const double K = B * B - 4 * A * C;
+    double y = extent;
+    double disc = K * y * y + 4 * A * D;
+    double delta = K * (1 - 2 * y);     // disc(y - 1) - disc(y)
+    const double inverse2A = 0.5 / A;
+    for (int i = 0; i <= extent * 2; ++i)
+    {
+        const double root = sqrt(std::max(disc, 0.0));
+        (*lefts)[i] = (int) ceil((-B * y - root) * inverse2A);
+        (*rights)[i] = (int) floor((-B * y + root) * inverse2A);
+        disc += delta;
+        delta += 2 * K;
+        y -= 1;
+    }
+    return extent;
+}
+
+// Clipped spans of rows yMid - extent to yMid + extent (see
+// RotatedEllipseSpans) through the span kernels. Blend modes other than
+// Opaque read the color from source, as long as the widest span.
+inline void FillSpanRows(unsigned char* pixels, const int pitch, const ClipRect& clip,
+                         const int xMid, const int yMid, const int extent,
+                         const std::vector<int>& lefts, const std::vector<int>& rights,
+                         const unsigned int value, const BlendMode mode, const unsigned int* source)
+{
+    const Kernels& kernels = GetKernels();
+    const int yBegin = std::max(yMid - extent, clip.minY);
+    const int yEnd = std::min(yMid + extent, clip.maxY);
+    
+    for (int row = yBegin; row <= yEnd; ++row)
+    {
+        const int i = row - (yMid - extent);
+        const int xBegin = std::max(xMid + lefts[i], clip.minX);
+        const int xEnd = std::min(xMid + rights[i], clip.maxX) + 1;
+        if (xBegin >= xEnd)
+            continue;
+        
+        unsigned int* span = (unsigned int*) (pixels + row * pitch) + xBegin;
+        if (mode == BlendMode::Opaque)
+            kernels.fillSpan(span, xEnd - xBegin, value);
+        else
+            kernels.blendSpan[(int) mode](span, source, xEnd - xBegin);
+    }
+}
+
+// Outline of the same rows: the ends of every span, stretched to reach
+// the ends of the rows above and below so the outline stays connected.
+// Rows next to an empty one are the top or bottom and drawn whole.
+inline void DrawSpanRowsOutline(unsigned char* pixels, const int pitch, const ClipRect& clip,
+                                const int xMid, const int yMid, const int extent,
+                                const std::vector<int>& lefts, const std::vector<int>& rights,
+                                const unsigned int value)
+{
+    const Kernels& kernels = GetKernels();
+    const int rowCount = extent * 2 + 1;
+    const int yBegin = std::max(yMid - extent, clip.minY);
+    const int yEnd = std::min(yMid + extent, clip.maxY);
+    
+    for (int row = yBegin; row <= yEnd; ++row)
+    {
+        const int i = row - (yMid - extent);
+        const int left = lefts[i];
+        const int right = rights[i];
+        if (left > right)
+            continue;
+        
+        int pieces[2][2] = { { left, right }, { right + 1, right } };
+        const bool edge = i == 0 || i == rowCount - 1 || lefts[i - 1] > rights[i - 1] || lefts[i + 1] > rights[i + 1];
+        if (!edge)
+        {
+            const int leftEnd = std::max(left, std::max(lefts[i - 1], lefts[i + 1]) - 1);
+            const int rightBegin = std::min(right, std::min(rights[i - 1], rights[i + 1]) + 1);
+            pieces[0][1] = std::min(leftEnd, right);
+            pieces[1][0] = std::max(rightBegin, pieces[0][1] + 1);
+        }
+        
+        unsigned int* line = (unsigned int*) (pixels + row * pitch);
+        for (int k = 0; k < 2; ++k)
+        {
+            const int xBegin = std::max(xMid + pieces[k][0], clip.minX);
+            const int xEnd = std::min(xMid + pieces[k][1], clip.maxX) + 1;
+            if (xBegin < xEnd)
+                kernels.fillSpan(line + xBegin, xEnd - xBegin, value);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,204 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include "clip.h"
+#include "kernels.h"
+
+// Row y + dy is still to be searched between xLeft and xRight, coming from
+// the filled span on row y
+struct FillSegment
+{
+    int y;
+    int xLeft;
+    int xRight;
+    int dy;
+};
+
+// Scanline seed fill (Heckbert's): replaces the 4-connected region of
+// pixels equal to the seed pixel, one span at a time. Pending spans are on
+// an explicit stack that is kept between fills, so there is no recursion
+// and after the first fills no allocation either.
+class FloodFiller
+{
+private:
+    static const int BandHeight = 64;
+    
+    std::vector<FillSegment>                stack;
+    
+    // Parallel fill, per band of rows
+    std::vector<std::vector<FillSegment> >  bandStacks;
+    std::vector<std::vector<FillSegment> >  bandAbove;
+    std::vector<std::vector<FillSegment> >  bandBelow;
+    
+    // Rows outside of band go to above or below, or nowhere outside clip
+    static inline void Push(std::vector<FillSegment>& stack, const ClipRect& band, const ClipRect& clip,
+                            std::vector<FillSegment>* above, std::vector<FillSegment>* below,
+                            const int y, const int xLeft, const int xRight, const int dy)
+    {
+        const int row = y + dy;
+        if (row < clip.minY || row > clip.maxY)
+            return;
+        
+        const FillSegment segment = { y, xLeft, xRight, dy };
+        if (row < band.minY)
+            above->push_back(segment);
+        else if (row > band.maxY)
+            below->push_back(segment);
+        else
+            stack.push_back(segment);
+    }
+    
+    // Fills until the stack is empty, returns the number of pixels filled.
+    // Only rows of band are touched.
+    static int Run(unsigned char* pixels, const int pitch, const ClipRect& band, const ClipRect& clip,
+                   const unsigned int old, const unsigned int value, std::vector<FillSegment>& stack,
+                   std::vector<FillSegment>* above, std::vector<FillSegment>* below)
+    {
+        void (*fillSpan)(unsigned int*, int, unsigned int) = GetKernels().fillSpan;
+        int filled = 0;
+        
+        while (!stack.empty())
+        {
+            const FillSegment segment = stack.back();
+            stack.pop_back();
+            const int y = segment.y + segment.dy;
+            const int dy = segment.dy;
+            unsigned int* row = (unsigned int*) (pixels + y * pitch);
+            
+            // A run through xLeft may leak out to the left of the parent
+            int x = segment.xLeft;
+            while (x >= clip.minX && row[x] == old)
+                --x;
+            int left = x + 1;
+            bool inRun = x < segment.xLeft;
+            if (inRun && left < segment.xLeft)
+                Push(stack, band, clip, above, below, y, left, segment.xLeft - 1, -dy);
+            x = segment.xLeft + 1;
+            
+            for (;;)
+            {
+                if (inRun)
+                {
+                    while (x <= clip.maxX && row[x] == old)
+                        ++x;
+                    fillSpan(row + left, x - left, value);
+                    filled += x - left;
+                    Push(stack, band, clip, above, below, y, left, x - 1, dy);
+                    
+                    // Or to the right of it
+                    if (x > segment.xRight + 1)
+                        Push(stack, band, clip, above, below, y, segment.xRight + 1, x - 1, -dy);
+                    ++x;
+                }
+                
+                while (x <= segment.xRight && row[x] != old)
+                    ++x;
+                if (x > segment.xRight)
+                    break;
+                left = x;
+                inRun = true;
+            }
+        }
+        return filled;
+    }
+    
+public:
+    FloodFiller(const int capacity = 4096)
+    {
+        this->stack.reserve(capacity);
+    }
+    
+    // Fills the region around (x, y), both in backbuffer coordinates and
+    // limited to clip. Returns the number of pixels filled.
+    int Fill(unsigned char* pixels, const int pitch, const ClipRect& clip,
+             const int x, const int y, const unsigned int value)
+    {
+        if (x < clip.minX || x > clip.maxX || y < clip.minY || y > clip.maxY)
+            return 0;
+        const unsigned int old = ((unsigned int*) (pixels + y * pitch))[x];
+        if (old == value)
+            return 0;
+        
+        // The seed row first, then the row below it from the seed
+        this->stack.clear();
+        Push(this->stack, clip, clip, nullptr, nullptr, y, x, x, 1);
+        Push(this->stack, clip, clip, nullptr, nullptr, y + 1, x, x, -1);
+        return Run(pixels, pitch, clip, clip, old, value, this->stack, nullptr, nullptr);
+    }
+    
+    // Same result, with the rows split in bands filled in parallel. A band
+    // fills everything it reaches inside itself and hands spans that cross
+    // its top or bottom to the neighbour, which picks them up in the next
+    // round. Regions that wind up and down a lot take many rounds, large
+    // ones spread over all bands at once.
+    int FillParallel(unsigned char* pixels, const int pitch, const ClipRect& clip,
+                     const int x, const int y, const unsigned int value)
+    {
+        if (x < clip.minX || x > clip.maxX || y < clip.minY || y > clip.maxY)
+            return 0;
+        const unsigned int old = ((unsigned int*) (pixels + y * pitch))[x];
+        if (old == value)
+            return 0;
+        
+        const int bandCount = (clip.maxY - clip.minY + BandHeight) / BandHeight;
+        if ((int) this->bandStacks.size() < bandCount)
+        {
+            this->bandStacks.resize(bandCount);
+            this->bandAbove.resize(bandCount);
+            this->bandBelow.resize(bandCount);
+        }
+        for (int band = 0; band < bandCount; ++band)
+        {
+            this->bandStacks[band].clear();
+            this->bandAbove[band].clear();
+            this->bandBelow[band].clear();
+        }
+        
+        const int seedBand = (y - clip.minY) / BandHeight;
+        ClipRect seedRows = clip;
+        seedRows.minY = clip.minY + seedBand * BandHeight;
+        seedRows.maxY = std::min(seedRows.minY + BandHeight - 1, clip.maxY);
+        Push(this->bandStacks[seedBand], seedRows, clip, &this->bandAbove[seedBand], &this->bandBelow[seedBand],
+             y, x, x, 1);
+        Push(this->bandStacks[seedBand], seedRows, clip, &this->bandAbove[seedBand], &this->bandBelow[seedBand],
+             y + 1, x, x, -1);
+        
+        int filled = 0;
+        for (bool pending = true; pending; )
+        {
+            #pragma omp parallel for schedule(dynamic) reduction(+: filled)
+            for (int band = 0; band < bandCount; ++band)
+            {
+                if (this->bandStacks[band].empty())
+                    continue;
+                
+                ClipRect rows = clip;
+                rows.minY = clip.minY + band * BandHeight;
+                rows.maxY = std::min(rows.minY + BandHeight - 1, clip.maxY);
+                filled += Run(pixels, pitch, rows, clip, old, value, this->bandStacks[band],
+                              &this->bandAbove[band], &this->bandBelow[band]);
+            }
+            
+            // Hand the spans over the borders to the neighbours
+            pending = false;
+            for (int band = 0; band < bandCount; ++band)
+            {
+                if (band > 0)
+                {
+                    std::vector<FillSegment>& target = this->bandStacks[band - 1];
+                    target.insert(target.end(), this->bandAbove[band].begin(), this->bandAbove[band].end());
+                }
+                if (band + 1 < bandCount)
+                {
+                    std::vector<FillSegment>& target = this->bandStacks[band + 1];
+                    target.insert(target.end(), this->bandBelow[band].begin(), this->bandBelow[band].end());
+                }
+                this->bandAbove[band].clear();
+                this->bandBelow[band].clear();
+            }
+            for (int band = 0; band < bandCount; ++band)
+                pending = pending || !this->bandStacks[band].empty();
+        }
+        return filled;
+    }
+};
\ No newline at end of file
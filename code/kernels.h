@@ -0,0 +1,484 @@
+#pragma once
+#include <emmintrin.h>
+#include <immintrin.h>
+#include <algorithm>
+#include "cpu.h"
+#include "math/vec4.h"
+#include "math/mat4x4.h"
+
+// Hot loops in one variant per ISA, picked once at startup by GetKernels.
+// Wider variants hand their tails to the SSE2 one, so every variant gives
+// bit identical results.
+
+// Blending works on premultiplied ARGB8888, all four channels alike
+enum class BlendMode
+{
+    Opaque,     // s
+    SrcOver,    // s + d * (1 - sa)
+    Additive,   // s + d, saturated
+    Multiply,   // s * d + s * (1 - da) + d * (1 - sa)
+    Count,
+};
+
+// x / 255 rounded, exact for x <= 255 * 255: (t + (t >> 8)) >> 8, t = x + 128
+inline unsigned int Div255(const unsigned int x)
+{
+    const unsigned int t = x + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+template<BlendMode Mode>
+inline unsigned int BlendPixel(const unsigned int s, const unsigned int d)
+{
+    if (Mode == BlendMode::Opaque)
+        return s;
+
+    const unsigned int sa = s >> 24;
+    const unsigned int da = d >> 24;
+    unsigned int result = 0;
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        const unsigned int sc = (s >> shift) & 0xFF;
+        const unsigned int dc = (d >> shift) & 0xFF;
+        unsigned int c;
+        if (Mode == BlendMode::SrcOver)
+            c = sc + Div255(dc * (255 - sa));
+        else if (Mode == BlendMode::Additive)
+            c = sc + dc;
+        else
+            c = Div255(sc * (dc + 255 - da) + dc * (255 - sa));
+        result |= std::min(c, 255u) << shift;
+    }
+    return result;
+}
+
+// SSE2 -----------------------------------------------------------------------
+
+inline void FillSpanSse2(unsigned int* pixels, const int count, const unsigned int value)
+{
+    const __m128i v = _mm_set1_epi32((int) value);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_si128((__m128i*) (pixels + i), v);
+    for (; i < count; ++i)
+        pixels[i] = value;
+}
+
+inline void FillDepthSse2(float* depths, const int count, const float value)
+{
+    const __m128 v = _mm_set1_ps(value);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(depths + i, v);
+    for (; i < count; ++i)
+        depths[i] = value;
+}
+
+// The 16 bit lanes of a premultiplied blend, for one half of the pixels
+// (unpacked to 16 bits per channel). Alphas are broadcast to all four
+// channels of their pixel.
+inline __m128i BlendChannels(const BlendMode mode, const __m128i s, const __m128i d,
+                             const __m128i sa, const __m128i da)
+{
+    const __m128i max = _mm_set1_epi16(255);
+    __m128i t;
+    if (mode == BlendMode::SrcOver)
+        t = _mm_mullo_epi16(d, _mm_sub_epi16(max, sa));
+    else
+        t = _mm_add_epi16(_mm_mullo_epi16(s, _mm_sub_epi16(_mm_add_epi16(d, max), da)),
+                          _mm_mullo_epi16(d, _mm_sub_epi16(max, sa)));
+    t = _mm_add_epi16(t, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+template<BlendMode Mode>
+inline __m128i BlendPixels4(const __m128i s, const __m128i d)
+{
+    if (Mode == BlendMode::Opaque)
+        return s;
+    if (Mode == BlendMode::Additive)
+        return _mm_adds_epu8(s, d);
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i sLo = _mm_unpacklo_epi8(s, zero), sHi = _mm_unpackhi_epi8(s, zero);
+    const __m128i dLo = _mm_unpacklo_epi8(d, zero), dHi = _mm_unpackhi_epi8(d, zero);
+    const __m128i saLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sLo, 0xFF), 0xFF);
+    const __m128i saHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sHi, 0xFF), 0xFF);
+    const __m128i daLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(dLo, 0xFF), 0xFF);
+    const __m128i daHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(dHi, 0xFF), 0xFF);
+    const __m128i blended = _mm_packus_epi16(BlendChannels(Mode, sLo, dLo, saLo, daLo),
+                                             BlendChannels(Mode, sHi, dHi, saHi, daHi));
+
+    // Src-over only scaled the destination
+    return Mode == BlendMode::SrcOver ? _mm_adds_epu8(s, blended) : blended;
+}
+
+template<BlendMode Mode>
+inline void BlendSpanSse2(unsigned int* dst, const unsigned int* src, const int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128i s = _mm_loadu_si128((const __m128i*) (src + i));
+        const __m128i d = _mm_loadu_si128((const __m128i*) (dst + i));
+        _mm_storeu_si128((__m128i*) (dst + i), BlendPixels4<Mode>(s, d));
+    }
+    for (; i < count; ++i)
+        dst[i] = BlendPixel<Mode>(src[i], dst[i]);
+}
+
+inline void TransformVerticesSse2(const Mat4x4<float>& matrix, const float* xs, const float* ys, const float* zs,
+                                  Vec4<float>* out, const int count)
+{
+    const float* m = matrix.m;
+    __m128 rows[16];
+    for (int k = 0; k < 16; ++k)
+        rows[k] = _mm_set1_ps(m[k]);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(xs + i);
+        const __m128 y = _mm_loadu_ps(ys + i);
+        const __m128 z = _mm_loadu_ps(zs + i);
+        __m128 r[4];
+        for (int k = 0; k < 4; ++k)
+        {
+            r[k] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rows[k * 4], x), _mm_mul_ps(rows[k * 4 + 1], y)),
+                              _mm_add_ps(_mm_mul_ps(rows[k * 4 + 2], z), rows[k * 4 + 3]));
+        }
+        _MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+        for (int k = 0; k < 4; ++k)
+            _mm_storeu_ps(&out[i + k].x, r[k]);
+    }
+    // Same order of operations as above, so where the tail starts does not
+    // change the results
+    for (; i < count; ++i)
+    {
+        float r[4];
+        for (int k = 0; k < 4; ++k)
+            r[k] = (m[k * 4] * xs[i] + m[k * 4 + 1] * ys[i]) + (m[k * 4 + 2] * zs[i] + m[k * 4 + 3]);
+        out[i] = Vec4<float>(r[0], r[1], r[2], r[3]);
+    }
+}
+
+// Minor axis coordinates of a DDA line: (start + i * step) >> 16
+inline void StepLineSse2(const int start, const int step, const int count, int* out)
+{
+    __m128i v = _mm_setr_epi32(start, start + step, start + step * 2, start + step * 3);
+    const __m128i step4 = _mm_set1_epi32(step * 4);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        _mm_storeu_si128((__m128i*) (out + i), _mm_srai_epi32(v, 16));
+        v = _mm_add_epi32(v, step4);
+    }
+    for (; i < count; ++i)
+        out[i] = (start + i * step) >> 16;
+}
+
+// AVX2 -----------------------------------------------------------------------
+
+TARGET_AVX2 inline void FillSpanAvx2(unsigned int* pixels, const int count, const unsigned int value)
+{
+    const __m256i v = _mm256_set1_epi32((int) value);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_si256((__m256i*) (pixels + i), v);
+    FillSpanSse2(pixels + i, count - i, value);
+}
+
+TARGET_AVX2 inline void FillDepthAvx2(float* depths, const int count, const float value)
+{
+    const __m256 v = _mm256_set1_ps(value);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(depths + i, v);
+    FillDepthSse2(depths + i, count - i, value);
+}
+
+TARGET_AVX2 inline __m256i BlendChannels8(const BlendMode mode, const __m256i s, const __m256i d,
+                                           const __m256i sa, const __m256i da)
+{
+    const __m256i max = _mm256_set1_epi16(255);
+    __m256i t;
+    if (mode == BlendMode::SrcOver)
+        t = _mm256_mullo_epi16(d, _mm256_sub_epi16(max, sa));
+    else
+        t = _mm256_add_epi16(_mm256_mullo_epi16(s, _mm256_sub_epi16(_mm256_add_epi16(d, max), da)),
+                             _mm256_mullo_epi16(d, _mm256_sub_epi16(max, sa)));
+    t = _mm256_add_epi16(t, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+// Unpacks work per 128 bit lane, the pack at the end undoes that
+template<BlendMode Mode>
+TARGET_AVX2 inline __m256i BlendPixels8(const __m256i s, const __m256i d)
+{
+    if (Mode == BlendMode::Opaque)
+        return s;
+    if (Mode == BlendMode::Additive)
+        return _mm256_adds_epu8(s, d);
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i sLo = _mm256_unpacklo_epi8(s, zero), sHi = _mm256_unpackhi_epi8(s, zero);
+    const __m256i dLo = _mm256_unpacklo_epi8(d, zero), dHi = _mm256_unpackhi_epi8(d, zero);
+    const __m256i saLo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sLo, 0xFF), 0xFF);
+    const __m256i saHi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sHi, 0xFF), 0xFF);
+    const __m256i daLo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(dLo, 0xFF), 0xFF);
+    const __m256i daHi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(dHi, 0xFF), 0xFF);
+    const __m256i blended = _mm256_packus_epi16(BlendChannels8(Mode, sLo, dLo, saLo, daLo),
+                                                BlendChannels8(Mode, sHi, dHi, saHi, daHi));
+    return Mode == BlendMode::SrcOver ? _mm256_adds_epu8(s, blended) : blended;
+}
+
+template<BlendMode Mode>
+TARGET_AVX2 inline void BlendSpanAvx2(unsigned int* dst, const unsigned int* src, const int count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256i s = _mm256_loadu_si256((const __m256i*) (src + i));
+        const __m256i d = _mm256_loadu_si256((const __m256i*) (dst + i));
+        _mm256_storeu_si256((__m256i*) (dst + i), BlendPixels8<Mode>(s, d));
+    }
+    BlendSpanSse2<Mode>(dst + i, src + i, count - i);
+}
+
+// Stores 8 vertices given as x, y, z, w registers to 8 consecutive Vec4
+TARGET_AVX2 inline void StoreVertices8(const __m256 x, const __m256 y, const __m256 z, const __m256 w, float* out)
+{
+    const __m256 t0 = _mm256_unpacklo_ps(x, y);
+    const __m256 t1 = _mm256_unpackhi_ps(x, y);
+    const __m256 t2 = _mm256_unpacklo_ps(z, w);
+    const __m256 t3 = _mm256_unpackhi_ps(z, w);
+    const __m256 v04 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 v15 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 v26 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 v37 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    _mm256_storeu_ps(out, _mm256_permute2f128_ps(v04, v15, 0x20));
+    _mm256_storeu_ps(out + 8, _mm256_permute2f128_ps(v26, v37, 0x20));
+    _mm256_storeu_ps(out + 16, _mm256_permute2f128_ps(v04, v15, 0x31));
+    _mm256_storeu_ps(out + 24, _mm256_permute2f128_ps(v26, v37, 0x31));
+}
+
+TARGET_AVX2 inline void TransformVerticesAvx2(const Mat4x4<float>& matrix, const float* xs, const float* ys,
+                                              const float* zs, Vec4<float>* out, const int count)
+{
+    const float* m = matrix.m;
+    __m256 rows[16];
+    for (int k = 0; k < 16; ++k)
+        rows[k] = _mm256_set1_ps(m[k]);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(xs + i);
+        const __m256 y = _mm256_loadu_ps(ys + i);
+        const __m256 z = _mm256_loadu_ps(zs + i);
+        // No FMA: it rounds once where the SSE2 variant rounds twice
+        __m256 r[4];
+        for (int k = 0; k < 4; ++k)
+        {
+            r[k] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rows[k * 4], x), _mm256_mul_ps(rows[k * 4 + 1], y)),
+                                 _mm256_add_ps(_mm256_mul_ps(rows[k * 4 + 2], z), rows[k * 4 + 3]));
+        }
+        StoreVertices8(r[0], r[1], r[2], r[3], &out[i].x);
+    }
+    TransformVerticesSse2(matrix, xs + i, ys + i, zs + i, out + i, count - i);
+}
+
+TARGET_AVX2 inline void StepLineAvx2(const int start, const int step, const int count, int* out)
+{
+    __m256i v = _mm256_add_epi32(_mm256_set1_epi32(start),
+                                 _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(step)));
+    const __m256i step8 = _mm256_set1_epi32(step * 8);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        _mm256_storeu_si256((__m256i*) (out + i), _mm256_srai_epi32(v, 16));
+        v = _mm256_add_epi32(v, step8);
+    }
+    StepLineSse2(start + i * step, step, count - i, out + i);
+}
+
+// AVX-512 --------------------------------------------------------------------
+
+#if defined(HAS_AVX512_INTRINSICS)
+TARGET_AVX512 inline void FillSpanAvx512(unsigned int* pixels, const int count, const unsigned int value)
+{
+    const __m512i v = _mm512_set1_epi32((int) value);
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+        _mm512_storeu_si512((void*) (pixels + i), v);
+    if (i < count)
+        _mm512_mask_storeu_epi32(pixels + i, (__mmask16) ((1 << (count - i)) - 1), v);
+}
+
+TARGET_AVX512 inline void FillDepthAvx512(float* depths, const int count, const float value)
+{
+    const __m512 v = _mm512_set1_ps(value);
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+        _mm512_storeu_ps(depths + i, v);
+    if (i < count)
+        _mm512_mask_storeu_ps(depths + i, (__mmask16) ((1 << (count - i)) - 1), v);
+}
+
+TARGET_AVX512 inline __m512i BlendChannels16(const BlendMode mode, const __m512i s, const __m512i d,
+                                              const __m512i sa, const __m512i da)
+{
+    const __m512i max = _mm512_set1_epi16(255);
+    __m512i t;
+    if (mode == BlendMode::SrcOver)
+        t = _mm512_mullo_epi16(d, _mm512_sub_epi16(max, sa));
+    else
+        t = _mm512_add_epi16(_mm512_mullo_epi16(s, _mm512_sub_epi16(_mm512_add_epi16(d, max), da)),
+                             _mm512_mullo_epi16(d, _mm512_sub_epi16(max, sa)));
+    t = _mm512_add_epi16(t, _mm512_set1_epi16(128));
+    return _mm512_srli_epi16(_mm512_add_epi16(t, _mm512_srli_epi16(t, 8)), 8);
+}
+
+template<BlendMode Mode>
+TARGET_AVX512 inline __m512i BlendPixels16(const __m512i s, const __m512i d)
+{
+    if (Mode == BlendMode::Opaque)
+        return s;
+    if (Mode == BlendMode::Additive)
+        return _mm512_adds_epu8(s, d);
+
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i sLo = _mm512_unpacklo_epi8(s, zero), sHi = _mm512_unpackhi_epi8(s, zero);
+    const __m512i dLo = _mm512_unpacklo_epi8(d, zero), dHi = _mm512_unpackhi_epi8(d, zero);
+    const __m512i saLo = _mm512_shufflehi_epi16(_mm512_shufflelo_epi16(sLo, 0xFF), 0xFF);
+    const __m512i saHi = _mm512_shufflehi_epi16(_mm512_shufflelo_epi16(sHi, 0xFF), 0xFF);
+    const __m512i daLo = _mm512_shufflehi_epi16(_mm512_shufflelo_epi16(dLo, 0xFF), 0xFF);
+    const __m512i daHi = _mm512_shufflehi_epi16(_mm512_shufflelo_epi16(dHi, 0xFF), 0xFF);
+    const __m512i blended = _mm512_packus_epi16(BlendChannels16(Mode, sLo, dLo, saLo, daLo),
+                                                BlendChannels16(Mode, sHi, dHi, saHi, daHi));
+    return Mode == BlendMode::SrcOver ? _mm512_adds_epu8(s, blended) : blended;
+}
+
+template<BlendMode Mode>
+TARGET_AVX512 inline void BlendSpanAvx512(unsigned int* dst, const unsigned int* src, const int count)
+{
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m512i s = _mm512_loadu_si512((const void*) (src + i));
+        const __m512i d = _mm512_loadu_si512((const void*) (dst + i));
+        _mm512_storeu_si512((void*) (dst + i), BlendPixels16<Mode>(s, d));
+    }
+    BlendSpanAvx2<Mode>(dst + i, src + i, count - i);
+}
+
+TARGET_AVX512 inline void TransformVerticesAvx512(const Mat4x4<float>& matrix, const float* xs, const float* ys,
+                                                  const float* zs, Vec4<float>* out, const int count)
+{
+    const float* m = matrix.m;
+    __m512 rows[16];
+    for (int k = 0; k < 16; ++k)
+        rows[k] = _mm512_set1_ps(m[k]);
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m512 x = _mm512_loadu_ps(xs + i);
+        const __m512 y = _mm512_loadu_ps(ys + i);
+        const __m512 z = _mm512_loadu_ps(zs + i);
+        // No FMA, see TransformVerticesAvx2
+        __m256 lo[4], hi[4];
+        for (int k = 0; k < 4; ++k)
+        {
+            const __m512 r = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(rows[k * 4], x),
+                                                         _mm512_mul_ps(rows[k * 4 + 1], y)),
+                                           _mm512_add_ps(_mm512_mul_ps(rows[k * 4 + 2], z), rows[k * 4 + 3]));
+            lo[k] = _mm512_castps512_ps256(r);
+            hi[k] = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(r), 1));
+        }
+        StoreVertices8(lo[0], lo[1], lo[2], lo[3], &out[i].x);
+        StoreVertices8(hi[0], hi[1], hi[2], hi[3], &out[i + 8].x);
+    }
+    TransformVerticesAvx2(matrix, xs + i, ys + i, zs + i, out + i, count - i);
+}
+
+TARGET_AVX512 inline void StepLineAvx512(const int start, const int step, const int count, int* out)
+{
+    __m512i v = _mm512_add_epi32(_mm512_set1_epi32(start),
+                                 _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                                                                      8, 9, 10, 11, 12, 13, 14, 15),
+                                                    _mm512_set1_epi32(step)));
+    const __m512i step16 = _mm512_set1_epi32(step * 16);
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        _mm512_storeu_si512((void*) (out + i), _mm512_srai_epi32(v, 16));
+        v = _mm512_add_epi32(v, step16);
+    }
+    StepLineSse2(start + i * step, step, count - i, out + i);
+}
+#endif
+
+// Dispatch -------------------------------------------------------------------
+
+struct Kernels
+{
+    Isa     isa;        // Of the variants below, see GetIsaName to report it
+    void    (*fillSpan)(unsigned int* pixels, int count, unsigned int value);
+    void    (*fillDepth)(float* depths, int count, float value);
+    void    (*blendSpan[(int) BlendMode::Count])(unsigned int* dst, const unsigned int* src, int count);
+    void    (*transformVertices)(const Mat4x4<float>& matrix, const float* xs, const float* ys,
+                                 const float* zs, Vec4<float>* out, int count);
+    void    (*stepLine)(int start, int step, int count, int* out);
+};
+
+// Kernels of one ISA, which must be supported by the CPU
+inline Kernels GetKernels(const Isa isa)
+{
+    Kernels kernels;
+    kernels.isa = Isa::Sse2;
+    kernels.fillSpan = FillSpanSse2;
+    kernels.fillDepth = FillDepthSse2;
+    kernels.blendSpan[(int) BlendMode::Opaque] = BlendSpanSse2<BlendMode::Opaque>;
+    kernels.blendSpan[(int) BlendMode::SrcOver] = BlendSpanSse2<BlendMode::SrcOver>;
+    kernels.blendSpan[(int) BlendMode::Additive] = BlendSpanSse2<BlendMode::Additive>;
+    kernels.blendSpan[(int) BlendMode::Multiply] = BlendSpanSse2<BlendMode::Multiply>;
+    kernels.transformVertices = TransformVerticesSse2;
+    kernels.stepLine = StepLineSse2;
+
+    if (isa == Isa::Avx2)
+    {
+        kernels.isa = Isa::Avx2;
+        kernels.fillSpan = FillSpanAvx2;
+        kernels.fillDepth = FillDepthAvx2;
+        kernels.blendSpan[(int) BlendMode::Opaque] = BlendSpanAvx2<BlendMode::Opaque>;
+        kernels.blendSpan[(int) BlendMode::SrcOver] = BlendSpanAvx2<BlendMode::SrcOver>;
+        kernels.blendSpan[(int) BlendMode::Additive] = BlendSpanAvx2<BlendMode::Additive>;
+        kernels.blendSpan[(int) BlendMode::Multiply] = BlendSpanAvx2<BlendMode::Multiply>;
+        kernels.transformVertices = TransformVerticesAvx2;
+        kernels.stepLine = StepLineAvx2;
+    }
+#if defined(HAS_AVX512_INTRINSICS)
+    if (isa == Isa::Avx512)
+    {
+        kernels.isa = Isa::Avx512;
+        kernels.fillSpan = FillSpanAvx512;
+        kernels.fillDepth = FillDepthAvx512;
+        kernels.blendSpan[(int) BlendMode::Opaque] = BlendSpanAvx512<BlendMode::Opaque>;
+        kernels.blendSpan[(int) BlendMode::SrcOver] = BlendSpanAvx512<BlendMode::SrcOver>;
+        kernels.blendSpan[(int) BlendMode::Additive] = BlendSpanAvx512<BlendMode::Additive>;
+        kernels.blendSpan[(int) BlendMode::Multiply] = BlendSpanAvx512<BlendMode::Multiply>;
+        kernels.transformVertices = TransformVerticesAvx512;
+        kernels.stepLine = StepLineAvx512;
+    }
+#endif
+
+    return kernels;
+}
+
+// Kernels of the best ISA on this machine, detected on first use
+inline const Kernels& GetKernels()
+{
+    static const Kernels kernels = GetKernels(DetectIsa());
+    return kernels;
+}
\ No newline at end of file
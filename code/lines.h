@@ -0,0 +1,214 @@
+#pragma once
+#include <cstdlib>
+#include <algorithm>
+#include <emmintrin.h>
+#include "clip.h"
+#include "kernels.h"
+#include "math/fixed.h"
+
+// Lines step in 16.16 fixed point, which holds coordinates up to 32767.
+// Lines reaching out further are cut to this guard band first; all others
+// are clipped once by their range of steps, never per pixel.
+const ClipRect LineGuardBand = { -16384, -16384, 16384, 16384 };
+
+// Narrows [*begin, *end) to the steps i for which the DDA coordinate
+// (start + i * step) >> 16 is in [low, high]
+inline void ClipFixedSteps(const int start, const int step, const int low, const int high, int* begin, int* end)
+{
+    const long long lowFixed = (long long) low * Fixed16_16::One;
+    const long long endFixed = (long long) (high + 1) * Fixed16_16::One;
+    long long first = *begin, last = *end;
+    if (step > 0)
+    {
+        // ceil(a / step) = -FloorDiv(-a, step)
+        first = std::max(first, -FloorDiv(start - lowFixed, step));
+        last = std::min(last, -FloorDiv(start - endFixed, step));
+    }
+    else if (step < 0)
+    {
+        first = std::max(first, FloorDiv(start - endFixed, -step) + 1);
+        last = std::min(last, FloorDiv(start - lowFixed, -step) + 1);
+    }
+    else if (start < lowFixed || start >= endFixed)
+    {
+        last = first;
+    }
+    *begin = (int) first;
+    *end = (int) std::max(last, first);
+}
+
+// DDA line from (x0, y0) to (x1, y1) in backbuffer coordinates, both ends
+// included, stepping like SDLRenderer::DrawDDALine. Lines crossing the
+// clip rect are cut to the steps inside it, the pixels are written
+// unchecked.
+inline void DrawLinePixels(unsigned char* pixels, const int pitch, const ClipRect& clip,
+                           const int x0, const int y0, const int x1, const int y1, const unsigned int value)
+{
+    const int minX = std::min(x0, x1), minY = std::min(y0, y1);
+    const int maxX = std::max(x0, x1), maxY = std::max(y0, y1);
+    if (!clip.Intersects(minX, minY, maxX, maxY))
+        return;
+    if (!LineGuardBand.Contains(minX, minY, maxX, maxY))
+    {
+        const ClippedLine clipped = ClipLine(Line(x0, y0, x1, y1), LineGuardBand);
+        if (clipped.accepted)
+        {
+            DrawLinePixels(pixels, pitch, clip, clipped.line.x0, clipped.line.y0,
+                           clipped.line.x1, clipped.line.y1, value);
+        }
+        return;
+    }
+    
+    const int dx = x1 - x0;
+    const int dy = y1 - y0;
+    const bool xMajor = abs(dx) >= abs(dy);
+    const int length = xMajor ? abs(dx) : abs(dy);
+    const int majorStep = (xMajor ? dx : dy) < 0 ? -1 : 1;
+    const int m = length == 0 ? 0 : (int) (((long long) (xMajor ? dy : dx) * Fixed16_16::One) / length);
+    const int minor = (xMajor ? y0 : x0) * Fixed16_16::One + Fixed16_16::Half;
+    
+    int begin = 0;
+    int end = length + 1;
+    if (!clip.Contains(minX, minY, maxX, maxY))
+    {
+        ClipSteps(xMajor ? x0 : y0, majorStep, xMajor ? clip.minX : clip.minY, xMajor ? clip.maxX : clip.maxY,
+                  &begin, &end);
+        ClipFixedSteps(minor, m, xMajor ? clip.minY : clip.minX, xMajor ? clip.maxY : clip.maxX, &begin, &end);
+    }
+    
+    // Byte offsets of one step along either axis
+    const int majorStride = (xMajor ? 4 : pitch) * majorStep;
+    const int minorStride = xMajor ? pitch : 4;
+    unsigned char* start = pixels + (xMajor ? x0 * 4 : y0 * pitch);
+    
+    const int StepChunk = 64;
+    int minors[StepChunk];
+    const Kernels& kernels = GetKernels();
+    for (int i = begin; i < end; i += StepChunk)
+    {
+        const int count = std::min(StepChunk, end - i);
+        kernels.stepLine(minor + i * m, m, count, minors);
+        
+        unsigned char* chunk = start + i * majorStride;
+        for (int k = 0; k < count; ++k)
+            *(unsigned int*) (chunk + k * majorStride + minors[k] * minorStride) = value;
+    }
+}
+
+// color (premultiplied ARGB8888) times coverage / 255 for count coverages
+// of 0 to 255, rounded like Div255
+inline void ScaleColor(const unsigned int color, const unsigned int* coverage, unsigned int* out, const int count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i channels = _mm_unpacklo_epi8(_mm_set1_epi32((int) color), zero);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        // Every coverage to the four 16 bit channels of its pixel
+        const __m128i c = _mm_loadu_si128((const __m128i*) (coverage + i));
+        const __m128i pairs = _mm_unpacklo_epi16(_mm_packs_epi32(c, c), _mm_packs_epi32(c, c));
+        const __m128i t0 = _mm_add_epi16(_mm_mullo_epi16(channels, _mm_unpacklo_epi32(pairs, pairs)), bias);
+        const __m128i t1 = _mm_add_epi16(_mm_mullo_epi16(channels, _mm_unpackhi_epi32(pairs, pairs)), bias);
+        const __m128i r0 = _mm_srli_epi16(_mm_add_epi16(t0, _mm_srli_epi16(t0, 8)), 8);
+        const __m128i r1 = _mm_srli_epi16(_mm_add_epi16(t1, _mm_srli_epi16(t1, 8)), 8);
+        _mm_storeu_si128((__m128i*) (out + i), _mm_packus_epi16(r0, r1));
+    }
+    for (; i < count; ++i)
+    {
+        out[i] = (Div255((color >> 24) * coverage[i]) << 24) | (Div255(((color >> 16) & 0xFF) * coverage[i]) << 16)
+               | (Div255(((color >> 8) & 0xFF) * coverage[i]) << 8) | Div255((color & 0xFF) * coverage[i]);
+    }
+}
+
+// Anti-aliased (Wu) line in backbuffer coordinates. Every step along the
+// major axis splits the color between the two pixels around the exact
+// minor coordinate, by the top 8 bits of the 16.16 fraction. The pixels of
+// a chunk of steps are gathered, blended SrcOver by the span kernel and
+// scattered back.
+inline void DrawLineWu(unsigned char* pixels, const int pitch, const ClipRect& clip,
+                       const int x0, const int y0, const int x1, const int y1, const unsigned int color)
+{
+    // The second pixel of a step is one further on the minor axis
+    const int minX = std::min(x0, x1), minY = std::min(y0, y1);
+    const int maxX = std::max(x0, x1) + 1, maxY = std::max(y0, y1) + 1;
+    if (!clip.Intersects(minX, minY, maxX, maxY))
+        return;
+    if (!LineGuardBand.Contains(minX, minY, maxX - 1, maxY - 1))
+    {
+        const ClippedLine clipped = ClipLine(Line(x0, y0, x1, y1), LineGuardBand);
+        if (clipped.accepted)
+        {
+            DrawLineWu(pixels, pitch, clip, clipped.line.x0, clipped.line.y0,
+                       clipped.line.x1, clipped.line.y1, color);
+        }
+        return;
+    }
+    
+    const bool inside = clip.Contains(minX, minY, maxX, maxY);
+    const int dx = x1 - x0;
+    const int dy = y1 - y0;
+    const bool xMajor = abs(dx) >= abs(dy);
+    const int length = xMajor ? abs(dx) : abs(dy);
+    const int majorStep = (xMajor ? dx : dy) < 0 ? -1 : 1;
+    const int m = length == 0 ? 0 : (int) (((long long) (xMajor ? dy : dx) * Fixed16_16::One) / length);
+    const int minor = (xMajor ? y0 : x0) * Fixed16_16::One;
+    
+    const int StepChunk = 64;
+    unsigned int* targets[StepChunk * 2];
+    unsigned int coverage[StepChunk * 2];
+    unsigned int source[StepChunk * 2];
+    unsigned int destination[StepChunk * 2];
+    void (*blendSpan)(unsigned int*, const unsigned int*, int) = GetKernels().blendSpan[(int) BlendMode::SrcOver];
+    
+    // Steps are clipped once: [begin, end) has a pixel inside, and in
+    // [innerBegin, innerEnd) both are. Only the steps in between, where the
+    // line runs along the minor axis border, test their pixels.
+    int begin = 0;
+    int end = length + 1;
+    int innerBegin = begin;
+    int innerEnd = end;
+    if (!inside)
+    {
+        const int minorMin = xMajor ? clip.minY : clip.minX;
+        const int minorMax = xMajor ? clip.maxY : clip.maxX;
+        ClipSteps(xMajor ? x0 : y0, majorStep, xMajor ? clip.minX : clip.minY, xMajor ? clip.maxX : clip.maxY,
+                  &begin, &end);
+        innerBegin = begin;
+        innerEnd = end;
+        ClipFixedSteps(minor, m, minorMin - 1, minorMax, &begin, &end);
+        ClipFixedSteps(minor, m, minorMin, minorMax - 1, &innerBegin, &innerEnd);
+    }
+    
+    for (int i = begin; i < end; i += StepChunk)
+    {
+        const int steps = std::min(StepChunk, end - i);
+        int count = 0;
+        for (int k = 0; k < steps; ++k)
+        {
+            const int position = minor + (i + k) * m;
+            const int major = (xMajor ? x0 : y0) + (i + k) * majorStep;
+            const unsigned int fraction = (position >> 8) & 0xFF;
+            const bool border = i + k < innerBegin || i + k >= innerEnd;
+            for (int side = 0; side < 2; ++side)
+            {
+                const unsigned int cover = side ? fraction : 255 - fraction;
+                const int x = xMajor ? major : (position >> 16) + side;
+                const int y = xMajor ? (position >> 16) + side : major;
+                if (cover == 0 || (border && !(x >= clip.minX && x <= clip.maxX && y >= clip.minY && y <= clip.maxY)))
+                    continue;
+                
+                targets[count] = (unsigned int*) (pixels + y * pitch) + x;
+                coverage[count] = cover;
+                count++;
+            }
+        }
+        
+        ScaleColor(color, coverage, source, count);
+        for (int k = 0; k < count; ++k)
+            destination[k] = *targets[k];
+        blendSpan(destination, source, count);
+        for (int k = 0; k < count; ++k)
+            *targets[k] = destination[k];
+    }
+}
\ No newline at end of file
@@ -0,0 +1,127 @@
+#pragma once
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+private:
+    const unsigned char*    data;
+    size_t                  size;
+#ifdef _WIN32
+    HANDLE                  file;
+    HANDLE                  mapping;
+#else
+    int                     file;
+#endif
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+public:
+    MappedFile()
+        : data(nullptr), size(0)
+#ifdef _WIN32
+        , file(INVALID_HANDLE_VALUE), mapping(nullptr)
+#else
+        , file(-1)
+#endif
+    {
+    }
+
+    ~MappedFile()
+    {
+        this->Close();
+    }
+
+    bool Open(const char* path)
+    {
+        this->Close();
+
+#ifdef _WIN32
+        this->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                 OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (this->file == INVALID_HANDLE_VALUE)
+        {
+            std::cout << "Could not open file: " << path << std::endl;
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(this->file, &fileSize);
+        this->size = (size_t) fileSize.QuadPart;
+        if (this->size == 0)
+            return true;
+
+        this->mapping = CreateFileMappingA(this->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (this->mapping)
+            this->data = (const unsigned char*) MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+        this->file = open(path, O_RDONLY);
+        if (this->file < 0)
+        {
+            std::cout << "Could not open file: " << path << std::endl;
+            return false;
+        }
+
+        struct stat status;
+        fstat(this->file, &status);
+        this->size = (size_t) status.st_size;
+        if (this->size == 0)
+            return true;
+
+        void* memory = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, this->file, 0);
+        if (memory != MAP_FAILED)
+            this->data = (const unsigned char*) memory;
+#endif
+
+        if (!this->data)
+        {
+            std::cout << "Could not map file: " << path << std::endl;
+            this->Close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (this->data)
+            UnmapViewOfFile(this->data);
+        if (this->mapping)
+            CloseHandle(this->mapping);
+        if (this->file != INVALID_HANDLE_VALUE)
+            CloseHandle(this->file);
+        this->mapping = nullptr;
+        this->file = INVALID_HANDLE_VALUE;
+#else
+        if (this->data)
+            munmap((void*) this->data, this->size);
+        if (this->file >= 0)
+            close(this->file);
+        this->file = -1;
+#endif
+        this->data = nullptr;
+        this->size = 0;
+    }
+
+    inline bool IsOpen() const { return this->data != nullptr; }
+    inline const unsigned char* GetData() const { return this->data; }
+    inline size_t GetSize() const { return this->size; }
+};
\ No newline at end of file
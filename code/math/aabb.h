@@ -0,0 +1,71 @@
+#pragma once
+#include <algorithm>
+#include "vec3.h"
+
+// Axis aligned bounding box. Default constructed it is empty (inverted),
+// so growing it by the first point or box gives that point or box.
+template<typename T>
+struct Aabb
+{
+    Vec3<T> min;
+    Vec3<T> max;
+    
+    Aabb()
+        : min(T(1e30), T(1e30), T(1e30)), max(T(-1e30), T(-1e30), T(-1e30))
+    {}
+    
+    Aabb(const Vec3<T>& min, const Vec3<T>& max)
+        : min(min), max(max)
+    {}
+    
+    bool IsEmpty() const
+    {
+        return this->min.x > this->max.x || this->min.y > this->max.y || this->min.z > this->max.z;
+    }
+    
+    void Grow(const Vec3<T>& point)
+    {
+        this->min.x = std::min(this->min.x, point.x);
+        this->min.y = std::min(this->min.y, point.y);
+        this->min.z = std::min(this->min.z, point.z);
+        this->max.x = std::max(this->max.x, point.x);
+        this->max.y = std::max(this->max.y, point.y);
+        this->max.z = std::max(this->max.z, point.z);
+    }
+    
+    void Grow(const Aabb& box)
+    {
+        this->Grow(box.min);
+        this->Grow(box.max);
+    }
+    
+    Vec3<T> Center() const
+    {
+        return (this->min + this->max) * (T) 0.5;
+    }
+    
+    Vec3<T> Extent() const
+    {
+        return this->max - this->min;
+    }
+    
+    T SurfaceArea() const
+    {
+        const Vec3<T> e = this->Extent();
+        return 2 * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+    
+    bool Contains(const Vec3<T>& point) const
+    {
+        return point.x >= this->min.x && point.x <= this->max.x &&
+               point.y >= this->min.y && point.y <= this->max.y &&
+               point.z >= this->min.z && point.z <= this->max.z;
+    }
+    
+    bool Overlaps(const Aabb& box) const
+    {
+        return this->min.x <= box.max.x && this->max.x >= box.min.x &&
+               this->min.y <= box.max.y && this->max.y >= box.min.y &&
+               this->min.z <= box.max.z && this->max.z >= box.min.z;
+    }
+};
\ No newline at end of file
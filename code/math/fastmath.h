@@ -0,0 +1,235 @@
+#pragma once
+#include <cmath>
+#include <emmintrin.h>
+
+enum class Precision
+{
+    Fast,       // Hardware estimates and short polynomials, ~1e-3 for sin/cos
+    Accurate,   // Close to full float precision
+};
+
+// floor() for SSE2, which has no rounding instruction
+inline __m128 Floor4(const __m128 x)
+{
+    const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmplt_ps(x, truncated), _mm_set1_ps(1.0f)));
+}
+
+// sin(x) and cos(x) of 4 angles at once. Range reduction to
+// [-pi/4, pi/4] is done in integers, so both results come out of one
+// pass and share all of the reduction work.
+template<bool Accurate>
+inline void SinCos4(const __m128 angles, __m128* sines, __m128* cosines)
+{
+    // Cephes single precision constants, see sse_mathfun.h by J. Pommier
+    const float FourOverPi = 1.27323954473516f;
+    const float PiOverFourA = 0.78515625f;
+    const float PiOverFourB = 2.4187564849853515625e-4f;
+    const float PiOverFourC = 3.77489497744594108e-8f;
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+
+    __m128 x = angles;
+    __m128 signSin = _mm_and_ps(x, signMask);
+    x = _mm_andnot_ps(signMask, x);
+
+    // Octant j, rounded up to an even number
+    __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(FourOverPi)));
+    j = _mm_add_epi32(j, _mm_set1_epi32(1));
+    j = _mm_and_si128(j, _mm_set1_epi32(~1));
+    const __m128 y = _mm_cvtepi32_ps(j);
+
+    const __m128 swapSignSin = _mm_castsi128_ps(
+        _mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29));
+    const __m128 signCos = _mm_castsi128_ps(
+        _mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)),
+                                        _mm_set1_epi32(4)), 29));
+    const __m128 polyMask = _mm_castsi128_ps(
+        _mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+    signSin = _mm_xor_ps(signSin, swapSignSin);
+
+    // x - y * pi/4, split in parts to keep the bits of x
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(PiOverFourA)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(PiOverFourB)));
+    if (Accurate)
+        x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(PiOverFourC)));
+
+    const __m128 z = _mm_mul_ps(x, x);
+    __m128 polyCos, polySin;
+
+    if (Accurate)
+    {
+        // Cephes minimax polynomials
+        polyCos = _mm_set1_ps(2.443315711809948e-5f);
+        polyCos = _mm_add_ps(_mm_mul_ps(polyCos, z), _mm_set1_ps(-1.388731625493765e-3f));
+        polyCos = _mm_add_ps(_mm_mul_ps(polyCos, z), _mm_set1_ps(4.166664568298827e-2f));
+        polyCos = _mm_mul_ps(_mm_mul_ps(polyCos, z), z);
+        polyCos = _mm_sub_ps(polyCos, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+        polyCos = _mm_add_ps(polyCos, _mm_set1_ps(1.0f));
+
+        polySin = _mm_set1_ps(-1.9515295891e-4f);
+        polySin = _mm_add_ps(_mm_mul_ps(polySin, z), _mm_set1_ps(8.3321608736e-3f));
+        polySin = _mm_add_ps(_mm_mul_ps(polySin, z), _mm_set1_ps(-1.6666654611e-1f));
+        polySin = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(polySin, z), x), x);
+    }
+    else
+    {
+        // Abramowitz & Stegun 4.3.96 and 4.3.98
+        polyCos = _mm_set1_ps(0.03705f);
+        polyCos = _mm_add_ps(_mm_mul_ps(polyCos, z), _mm_set1_ps(-0.49670f));
+        polyCos = _mm_add_ps(_mm_mul_ps(polyCos, z), _mm_set1_ps(1.0f));
+
+        polySin = _mm_set1_ps(0.00761f);
+        polySin = _mm_add_ps(_mm_mul_ps(polySin, z), _mm_set1_ps(-0.16605f));
+        polySin = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(polySin, z), x), x);
+    }
+
+    // Pick the polynomial per lane depending on the octant
+    const __m128 s = _mm_or_ps(_mm_and_ps(polyMask, polySin), _mm_andnot_ps(polyMask, polyCos));
+    const __m128 c = _mm_or_ps(_mm_and_ps(polyMask, polyCos), _mm_andnot_ps(polyMask, polySin));
+
+    *sines = _mm_xor_ps(s, signSin);
+    *cosines = _mm_xor_ps(c, signCos);
+}
+
+// 1 / sqrt(x) of 4 values at once
+template<bool Accurate>
+inline __m128 RSqrt4(const __m128 values)
+{
+    if (Accurate)
+        return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(values));
+
+    // Estimate (12 bits) + one Newton-Raphson step:
+    // e' = e * (1.5 - 0.5 * x * e * e)
+    const __m128 e = _mm_rsqrt_ps(values);
+    const __m128 halfX = _mm_mul_ps(values, _mm_set1_ps(0.5f));
+    const __m128 r = _mm_mul_ps(e, _mm_sub_ps(_mm_set1_ps(1.5f),
+                                              _mm_mul_ps(halfX, _mm_mul_ps(e, e))));
+    return r;
+}
+
+template<bool Accurate>
+inline void SinCosBatch(const float* angles, float* sines, float* cosines, const int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 s, c;
+        SinCos4<Accurate>(_mm_loadu_ps(angles + i), &s, &c);
+        _mm_storeu_ps(sines + i, s);
+        _mm_storeu_ps(cosines + i, c);
+    }
+
+    if (i < count)
+    {
+        float a[4] = { 0, 0, 0, 0 };
+        float s[4], c[4];
+        for (int k = 0; i + k < count; ++k)
+            a[k] = angles[i + k];
+
+        __m128 vs, vc;
+        SinCos4<Accurate>(_mm_loadu_ps(a), &vs, &vc);
+        _mm_storeu_ps(s, vs);
+        _mm_storeu_ps(c, vc);
+        for (int k = 0; i + k < count; ++k)
+        {
+            sines[i + k] = s[k];
+            cosines[i + k] = c[k];
+        }
+    }
+}
+
+template<bool Accurate>
+inline void RSqrtBatch(const float* values, float* results, const int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(results + i, RSqrt4<Accurate>(_mm_loadu_ps(values + i)));
+
+    for (; i < count; ++i)
+        _mm_store_ss(results + i, RSqrt4<Accurate>(_mm_set1_ps(values[i])));
+}
+
+template<bool Accurate>
+inline void NormalizeBatch(float* xs, float* ys, float* zs, const int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(xs + i);
+        const __m128 y = _mm_loadu_ps(ys + i);
+        const __m128 z = _mm_loadu_ps(zs + i);
+        const __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x),
+                                                           _mm_mul_ps(y, y)),
+                                                _mm_mul_ps(z, z));
+        const __m128 inverseLength = RSqrt4<Accurate>(lengthSquared);
+        _mm_storeu_ps(xs + i, _mm_mul_ps(x, inverseLength));
+        _mm_storeu_ps(ys + i, _mm_mul_ps(y, inverseLength));
+        _mm_storeu_ps(zs + i, _mm_mul_ps(z, inverseLength));
+    }
+
+    for (; i < count; ++i)
+    {
+        const float lengthSquared = xs[i] * xs[i] + ys[i] * ys[i] + zs[i] * zs[i];
+        float inverseLength;
+        _mm_store_ss(&inverseLength, RSqrt4<Accurate>(_mm_set1_ps(lengthSquared)));
+        xs[i] *= inverseLength;
+        ys[i] *= inverseLength;
+        zs[i] *= inverseLength;
+    }
+}
+
+// Sine and cosine of count angles (radians)
+inline void SinCos(const float* angles, float* sines, float* cosines,
+                   const int count, const Precision precision = Precision::Fast)
+{
+    if (precision == Precision::Accurate)
+        SinCosBatch<true>(angles, sines, cosines, count);
+    else
+        SinCosBatch<false>(angles, sines, cosines, count);
+}
+
+inline void SinCos(const float angle, float* sine, float* cosine,
+                   const Precision precision = Precision::Fast)
+{
+    if (precision == Precision::Accurate)
+    {
+        *sine = sinf(angle);
+        *cosine = cosf(angle);
+        return;
+    }
+
+    __m128 s, c;
+    SinCos4<false>(_mm_set1_ps(angle), &s, &c);
+    _mm_store_ss(sine, s);
+    _mm_store_ss(cosine, c);
+}
+
+// 1 / sqrt(x) of count values
+inline void RSqrt(const float* values, float* results, const int count,
+                  const Precision precision = Precision::Fast)
+{
+    if (precision == Precision::Accurate)
+        RSqrtBatch<true>(values, results, count);
+    else
+        RSqrtBatch<false>(values, results, count);
+}
+
+inline float RSqrt(const float value, const Precision precision = Precision::Fast)
+{
+    if (precision == Precision::Accurate)
+        return 1.0f / sqrtf(value);
+
+    float r;
+    _mm_store_ss(&r, RSqrt4<false>(_mm_set_ss(value)));
+    return r;
+}
+
+// Normalizes count vectors stored as separate x, y and z arrays in place
+inline void Normalize(float* xs, float* ys, float* zs, const int count,
+                      const Precision precision = Precision::Fast)
+{
+    if (precision == Precision::Accurate)
+        NormalizeBatch<true>(xs, ys, zs, count);
+    else
+        NormalizeBatch<false>(xs, ys, zs, count);
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+
+// Signed fixed point number with FracBits fractional bits in an int,
+// e.g. Fixed<4> is 28.4: 1/16th pixel precision for rasterization.
+template<int FracBits>
+struct Fixed
+{
+    static const int One = 1 << FracBits;
+    static const int Half = One >> 1;
+    static const int FracMask = One - 1;
+
+    int raw;
+
+    Fixed(int value = 0)
+        : raw(value * One)
+    {}
+
+    static Fixed FromRaw(int raw)
+    {
+        Fixed r;
+        r.raw = raw;
+        return r;
+    }
+
+    // Rounds to the nearest representable value
+    static Fixed FromFloat(float value)
+    {
+        const float scaled = value * One;
+        return FromRaw((int) (scaled >= 0 ? scaled + 0.5f : scaled - 0.5f));
+    }
+
+    float ToFloat() const
+    {
+        return this->raw * (1.0f / One);
+    }
+
+    // Integer conversions rely on >> being an arithmetic shift, which it
+    // is on every compiler we build with.
+    int Floor() const
+    {
+        return this->raw >> FracBits;
+    }
+
+    int Ceil() const
+    {
+        return (this->raw + FracMask) >> FracBits;
+    }
+
+    int Round() const
+    {
+        return (this->raw + Half) >> FracBits;
+    }
+
+    int Frac() const
+    {
+        return this->raw & FracMask;
+    }
+
+    Fixed operator-() const
+    {
+        return FromRaw(-this->raw);
+    }
+
+    Fixed operator+(const Fixed& rhs) const
+    {
+        return FromRaw(this->raw + rhs.raw);
+    }
+
+    Fixed operator-(const Fixed& rhs) const
+    {
+        return FromRaw(this->raw - rhs.raw);
+    }
+
+    Fixed operator*(const Fixed& rhs) const
+    {
+        return FromRaw((int) (((long long) this->raw * rhs.raw) >> FracBits));
+    }
+
+    Fixed operator/(const Fixed& rhs) const
+    {
+        return FromRaw((int) (((long long) this->raw * One) / rhs.raw));
+    }
+
+    void operator+=(const Fixed& rhs)
+    {
+        this->raw += rhs.raw;
+    }
+
+    void operator-=(const Fixed& rhs)
+    {
+        this->raw -= rhs.raw;
+    }
+
+    bool operator==(const Fixed& rhs) const { return this->raw == rhs.raw; }
+    bool operator!=(const Fixed& rhs) const { return this->raw != rhs.raw; }
+    bool operator<(const Fixed& rhs) const { return this->raw < rhs.raw; }
+    bool operator<=(const Fixed& rhs) const { return this->raw <= rhs.raw; }
+    bool operator>(const Fixed& rhs) const { return this->raw > rhs.raw; }
+    bool operator>=(const Fixed& rhs) const { return this->raw >= rhs.raw; }
+};
+
+typedef Fixed<4> Fixed28_4;
+typedef Fixed<16> Fixed16_16;
+
+// Floor of a / b for b > 0, also for negative a
+inline long long FloorDiv(long long a, long long b)
+{
+    const long long q = a / b;
+    return (q * b > a) ? q - 1 : q;
+}
\ No newline at end of file
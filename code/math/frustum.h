@@ -0,0 +1,61 @@
+#pragma once
+#include "plane.h"
+#include "mat4x4.h"
+
+template<typename T>
+struct Frustum
+{
+    enum
+    {
+        Left,
+        Right,
+        Bottom,
+        Top,
+        Near,
+        Far,
+        PlaneCount
+    };
+    
+    // Normals point inward
+    Plane<T> planes[PlaneCount];
+    
+    // Extracts the planes of a (view-)projection matrix (Gribb & Hartmann).
+    // With M = projection * view they are in world space.
+    static Frustum FromMatrix(const Mat4x4<T>& matrix)
+    {
+        const T* m = matrix.m;
+        
+        Frustum r;
+        r.planes[Left]   = Plane<T>(m[12] + m[0], m[13] + m[1], m[14] + m[2],  m[15] + m[3]).Normalized();
+        r.planes[Right]  = Plane<T>(m[12] - m[0], m[13] - m[1], m[14] - m[2],  m[15] - m[3]).Normalized();
+        r.planes[Bottom] = Plane<T>(m[12] + m[4], m[13] + m[5], m[14] + m[6],  m[15] + m[7]).Normalized();
+        r.planes[Top]    = Plane<T>(m[12] - m[4], m[13] - m[5], m[14] - m[6],  m[15] - m[7]).Normalized();
+        r.planes[Near]   = Plane<T>(m[12] + m[8], m[13] + m[9], m[14] + m[10], m[15] + m[11]).Normalized();
+        r.planes[Far]    = Plane<T>(m[12] - m[8], m[13] - m[9], m[14] - m[10], m[15] - m[11]).Normalized();
+        
+        return r;
+    }
+    
+    bool Contains(const Vec3<T>& point) const
+    {
+        for (int i = 0; i < PlaneCount; ++i)
+        {
+            if (this->planes[i].Distance(point) < 0)
+                return false;
+        }
+        
+        return true;
+    }
+    
+    // Conservative: may accept spheres near the frustum corners
+    bool IntersectsSphere(const Vec3<T>& center, T radius) const
+    {
+        for (int i = 0; i < PlaneCount; ++i)
+        {
+            if (this->planes[i].Distance(center) < -radius)
+                return false;
+        }
+        
+        return true;
+    }
+};
\ No newline at end of file
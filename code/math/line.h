@@ -1,4 +1,5 @@
 #pragma once
+#include "fixed.h"
 
 struct Line
 {
@@ -12,6 +13,19 @@ struct Line
     {}
 };
 
+// Endpoints with subpixel precision
+struct FixedLine
+{
+    Fixed28_4 x0;
+    Fixed28_4 y0;
+    Fixed28_4 x1;
+    Fixed28_4 y1;
+    
+    FixedLine(Fixed28_4 x0 = 0, Fixed28_4 y0 = 0, Fixed28_4 x1 = 0, Fixed28_4 y1 = 0)
+        : x0(x0), y0(y0), x1(x1), y1(y1)
+    {}
+};
+
 struct ClippedLine
 {
     Line line;
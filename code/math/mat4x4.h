@@ -1,5 +1,6 @@
 #pragma once
 #include <cmath>
+#include "fastmath.h"
 #include "vec3.h"
 #include "vec4.h"
 
@@ -10,109 +11,254 @@ struct Mat4x4
     
     Mat4x4(T d = 1)
     {
-        this->m = 
+        const T values[16] =
         {
             d, 0, 0, 0,
             0, d, 0, 0,
             0, 0, d, 0,
             0, 0, 0, d,                        
         };
+        this->Set(values);
+    }
+    
+    void Set(const T values[16])
+    {
+        for (int i = 0; i < 16; ++i)
+            this->m[i] = values[i];
     }
     
     void LoadIdentity()
     {
-        this->m = 
+        const T values[16] =
         {
             1, 0, 0, 0,
             0, 1, 0, 0,
             0, 0, 1, 0,
             0, 0, 0, 1,                        
-        }; 
+        };
+        this->Set(values);
     }
     
     void Translate(T tx, T ty, T tz)
     {
-        Mat4x4 translation;
-        translation.m = 
+        const T values[16] =
         {
             1, 0, 0, tx,
             0, 1, 0, ty,
             0, 0, 1, tz,
             0, 0, 0, 1,
         };
+        Mat4x4 translation;
+        translation.Set(values);
         
         *this = translation * (*this);
     }
     
     void Scale(T sx, T sy, T sz)
     {
-        Mat4x4 scale;
-        scale.m = 
+        const T values[16] =
         {
             sx, 0, 0, 0,
             0, sx, 0, 0,
             0, 0, sx, 0,
             0, 0, 0, 1,
         };
+        Mat4x4 scale;
+        scale.Set(values);
         
         *this = scale * (*this);
     }
     
     void RotateX(T angle)
     {
-        Mat4x4 rotation;
-        const T cost = (T) cos(angle);
-        const T sint = (T) sin(angle);
-        
-        rotation.m = 
+        this->RotateX((T) sin(angle), (T) cos(angle));
+    }
+    
+    void RotateX(T angle, Precision precision)
+    {
+        float sint, cost;
+        SinCos((float) angle, &sint, &cost, precision);
+        this->RotateX((T) sint, (T) cost);
+    }
+    
+    // Takes a precomputed sine and cosine, e.g. from a batched SinCos
+    // over the angles of many objects.
+    void RotateX(T sint, T cost)
+    {
+        const T values[16] =
         {
             1,  0,      0,      0,
             0,  cost,   -sint,  0,
             0,  sint,   cost,   0,
             0,  0,      0,      1,
         };
+        Mat4x4 rotation;
+        rotation.Set(values);
         
         *this = rotation * (*this);
     }
     
     void RotateY(T angle)
     {
-        Mat4x4 rotation;
-        const T cost = (T) cos(angle);
-        const T sint = (T) sin(angle);
-        
-        rotation.m = 
+        this->RotateY((T) sin(angle), (T) cos(angle));
+    }
+    
+    void RotateY(T angle, Precision precision)
+    {
+        float sint, cost;
+        SinCos((float) angle, &sint, &cost, precision);
+        this->RotateY((T) sint, (T) cost);
+    }
+    
+    void RotateY(T sint, T cost)
+    {
+        const T values[16] =
         {
             cost,   0,      sint,   0,
             0,      1,      0,      0,
             -sint,  0,      cost,   0,
             0,      0,      0,      1,
         };
+        Mat4x4 rotation;
+        rotation.Set(values);
         
         *this = rotation * (*this);
     }
     
     void RotateZ(T angle)
     {
-        Mat4x4 rotation;
-        const T cost = (T) cos(angle);
-        const T sint = (T) sin(angle);
-        
-        rotation.m = 
+        this->RotateZ((T) sin(angle), (T) cos(angle));
+    }
+    
+    void RotateZ(T angle, Precision precision)
+    {
+        float sint, cost;
+        SinCos((float) angle, &sint, &cost, precision);
+        this->RotateZ((T) sint, (T) cost);
+    }
+    
+    void RotateZ(T sint, T cost)
+    {
+        const T values[16] =
         {
             cost,   -sint,  0,  0,
             sint,   cost,   0,  0,
             0,      0,      1,  0,
             0,      0,      0,  1,
         };
+        Mat4x4 rotation;
+        rotation.Set(values);
         
         *this = rotation * (*this);
     }
     
-    Mat4x4 operator*(const Mat4x4& rhs) const
+    // Right-handed, camera looks down -z, clip z in [-w, w] like OpenGL.
+    // fovY is the vertical field of view in radians.
+    static Mat4x4 Perspective(T fovY, T aspect, T zNear, T zFar)
     {
+        const T f = 1 / (T) tan(fovY / 2);
+        const T depth = zNear - zFar;
+        
+        const T values[16] =
+        {
+            f / aspect, 0,  0,                          0,
+            0,          f,  0,                          0,
+            0,          0,  (zFar + zNear) / depth,     2 * zFar * zNear / depth,
+            0,          0,  -1,                         0,
+        };
         Mat4x4 r;
-        r.m = 
+        r.Set(values);
+        
+        return r;
+    }
+    
+    static Mat4x4 Orthographic(T left, T right, T bottom, T top, T zNear, T zFar)
+    {
+        const T width = right - left;
+        const T height = top - bottom;
+        const T depth = zFar - zNear;
+        
+        const T values[16] =
+        {
+            2 / width,  0,          0,          -(right + left) / width,
+            0,          2 / height, 0,          -(top + bottom) / height,
+            0,          0,          -2 / depth, -(zFar + zNear) / depth,
+            0,          0,          0,          1,
+        };
+        Mat4x4 r;
+        r.Set(values);
+        
+        return r;
+    }
+    
+    // View matrix of a camera at eye looking at target
+    static Mat4x4 LookAt(const Vec3<T>& eye, const Vec3<T>& target, const Vec3<T>& up)
+    {
+        const Vec3<T> forward = (target - eye).Normalized();
+        const Vec3<T> right = Vec3<T>::Cross(forward, up).Normalized();
+        const Vec3<T> cameraUp = Vec3<T>::Cross(right, forward);
+        
+        const T values[16] =
+        {
+            right.x,    right.y,    right.z,    -Vec3<T>::Dot(right, eye),
+            cameraUp.x, cameraUp.y, cameraUp.z, -Vec3<T>::Dot(cameraUp, eye),
+            -forward.x, -forward.y, -forward.z, Vec3<T>::Dot(forward, eye),
+            0,          0,          0,          1,
+        };
+        Mat4x4 r;
+        r.Set(values);
+        
+        return r;
+    }
+    
+    Mat4x4 Transposed() const
+    {
+        Mat4x4 r;
+        for (int row = 0; row < 4; ++row)
+            for (int column = 0; column < 4; ++column)
+                r.m[column * 4 + row] = this->m[row * 4 + column];
+        
+        return r;
+    }
+    
+    // General inverse by cofactors. A singular matrix gives the identity.
+    Mat4x4 Inverted() const
+    {
+        const T* a = this->m;
+        T inv[16];
+        
+        inv[0] = a[5]*a[10]*a[15] - a[5]*a[11]*a[14] - a[9]*a[6]*a[15] + a[9]*a[7]*a[14] + a[13]*a[6]*a[11] - a[13]*a[7]*a[10];
+        inv[4] = -a[4]*a[10]*a[15] + a[4]*a[11]*a[14] + a[8]*a[6]*a[15] - a[8]*a[7]*a[14] - a[12]*a[6]*a[11] + a[12]*a[7]*a[10];
+        inv[8] = a[4]*a[9]*a[15] - a[4]*a[11]*a[13] - a[8]*a[5]*a[15] + a[8]*a[7]*a[13] + a[12]*a[5]*a[11] - a[12]*a[7]*a[9];
+        inv[12] = -a[4]*a[9]*a[14] + a[4]*a[10]*a[13] + a[8]*a[5]*a[14] - a[8]*a[6]*a[13] - a[12]*a[5]*a[10] + a[12]*a[6]*a[9];
+        inv[1] = -a[1]*a[10]*a[15] + a[1]*a[11]*a[14] + a[9]*a[2]*a[15] - a[9]*a[3]*a[14] - a[13]*a[2]*a[11] + a[13]*a[3]*a[10];
+        inv[5] = a[0]*a[10]*a[15] - a[0]*a[11]*a[14] - a[8]*a[2]*a[15] + a[8]*a[3]*a[14] + a[12]*a[2]*a[11] - a[12]*a[3]*a[10];
+        inv[9] = -a[0]*a[9]*a[15] + a[0]*a[11]*a[13] + a[8]*a[1]*a[15] - a[8]*a[3]*a[13] - a[12]*a[1]*a[11] + a[12]*a[3]*a[9];
+        inv[13] = a[0]*a[9]*a[14] - a[0]*a[10]*a[13] - a[8]*a[1]*a[14] + a[8]*a[2]*a[13] + a[12]*a[1]*a[10] - a[12]*a[2]*a[9];
+        inv[2] = a[1]*a[6]*a[15] - a[1]*a[7]*a[14] - a[5]*a[2]*a[15] + a[5]*a[3]*a[14] + a[13]*a[2]*a[7] - a[13]*a[3]*a[6];
+        inv[6] = -a[0]*a[6]*a[15] + a[0]*a[7]*a[14] + a[4]*a[2]*a[15] - a[4]*a[3]*a[14] - a[12]*a[2]*a[7] + a[12]*a[3]*a[6];
+        inv[10] = a[0]*a[5]*a[15] - a[0]*a[7]*a[13] - a[4]*a[1]*a[15] + a[4]*a[3]*a[13] + a[12]*a[1]*a[7] - a[12]*a[3]*a[5];
+        inv[14] = -a[0]*a[5]*a[14] + a[0]*a[6]*a[13] + a[4]*a[1]*a[14] - a[4]*a[2]*a[13] - a[12]*a[1]*a[6] + a[12]*a[2]*a[5];
+        inv[3] = -a[1]*a[6]*a[11] + a[1]*a[7]*a[10] + a[5]*a[2]*a[11] - a[5]*a[3]*a[10] - a[9]*a[2]*a[7] + a[9]*a[3]*a[6];
+        inv[7] = a[0]*a[6]*a[11] - a[0]*a[7]*a[10] - a[4]*a[2]*a[11] + a[4]*a[3]*a[10] + a[8]*a[2]*a[7] - a[8]*a[3]*a[6];
+        inv[11] = -a[0]*a[5]*a[11] + a[0]*a[7]*a[9] + a[4]*a[1]*a[11] - a[4]*a[3]*a[9] - a[8]*a[1]*a[7] + a[8]*a[3]*a[5];
+        inv[15] = a[0]*a[5]*a[10] - a[0]*a[6]*a[9] - a[4]*a[1]*a[10] + a[4]*a[2]*a[9] + a[8]*a[1]*a[6] - a[8]*a[2]*a[5];
+        
+        const T determinant = a[0]*inv[0] + a[1]*inv[4] + a[2]*inv[8] + a[3]*inv[12];
+        Mat4x4 r;
+        if (determinant == 0)
+            return r;
+        
+        const T inverseDeterminant = 1 / determinant;
+        for (int i = 0; i < 16; ++i)
+            r.m[i] = inv[i] * inverseDeterminant;
+        
+        return r;
+    }
+    
+    Mat4x4 operator*(const Mat4x4& rhs) const
+    {
+        const T values[16] =
         {
             // Row 0
 			this->m[0]*rhs.m[0] + this->m[3]*rhs.m[12] + this->m[1]*rhs.m[4] + this->m[2]*rhs.m[8],
@@ -138,13 +284,15 @@ struct Mat4x4
 			this->m[14]*rhs.m[10] + this->m[15]*rhs.m[14] + this->m[12]*rhs.m[2] + this->m[13]*rhs.m[6],
 			this->m[14]*rhs.m[11] + this->m[15]*rhs.m[15] + this->m[12]*rhs.m[3] + this->m[13]*rhs.m[7],
         };
+        Mat4x4 r;
+        r.Set(values);
         
         return r;
     }
 	
-	Vec4 operator*(const Vec4& rhs) const
+	Vec4<T> operator*(const Vec4<T>& rhs) const
 	{
-		Vec4 r;
+		Vec4<T> r;
 		r.x = this->m[0]*rhs.x + this->m[1]*rhs.y + this->m[2]*rhs.z + this->m[3]*rhs.w;
 		r.y = this->m[4]*rhs.x + this->m[5]*rhs.y + this->m[6]*rhs.z + this->m[7]*rhs.w;
 		r.z = this->m[8]*rhs.x + this->m[9]*rhs.y + this->m[10]*rhs.z + this->m[11]*rhs.w;
@@ -153,9 +301,9 @@ struct Mat4x4
 		return r;
 	}
 	
-	Vec4 operator*(const Vec3& rhs) const
+	Vec4<T> operator*(const Vec3<T>& rhs) const
 	{
-		Vec4 r;
+		Vec4<T> r;
 		r.x = this->m[0]*rhs.x + this->m[1]*rhs.y + this->m[2]*rhs.z + this->m[3];
 		r.y = this->m[4]*rhs.x + this->m[5]*rhs.y + this->m[6]*rhs.z + this->m[7];
 		r.z = this->m[8]*rhs.x + this->m[9]*rhs.y + this->m[10]*rhs.z + this->m[11];
@@ -166,7 +314,7 @@ struct Mat4x4
     
     Mat4x4& operator=(const Mat4x4& m)
     {
-        this->m = m.m;
+        this->Set(m.m);
 		
 		return *this;
     }
@@ -0,0 +1,30 @@
+#pragma once
+#include <cmath>
+#include "vec3.h"
+
+// Points p with Dot(normal, p) + d >= 0 are on the inside (positive side)
+template<typename T>
+struct Plane
+{
+    Vec3<T> normal;
+    T d;
+    
+    Plane(const Vec3<T>& normal = Vec3<T>(0, 1, 0), T d = 0)
+        : normal(normal), d(d)
+    {}
+    
+    Plane(T a, T b, T c, T d)
+        : normal(a, b, c), d(d)
+    {}
+    
+    T Distance(const Vec3<T>& point) const
+    {
+        return Vec3<T>::Dot(this->normal, point) + this->d;
+    }
+    
+    Plane Normalized() const
+    {
+        const T inverseLength = 1 / this->normal.Length();
+        return Plane(this->normal * inverseLength, this->d * inverseLength);
+    }
+};
\ No newline at end of file
@@ -0,0 +1,273 @@
+#pragma once
+#include <cmath>
+#include <emmintrin.h>
+#include "fastmath.h"
+#include "vec3.h"
+#include "mat4x4.h"
+
+template<typename T>
+struct Quat
+{
+    T x, y, z, w;
+
+    Quat(T x = 0, T y = 0, T z = 0, T w = 1)
+        : x(x), y(y), z(z), w(w)
+    {}
+
+    // Axis must be normalized, angle is in radians like Mat4x4::Rotate*
+    static Quat FromAxisAngle(const Vec3<T>& axis, T angle)
+    {
+        const T halfAngle = angle / 2;
+        return FromAxisAngle(axis, (T) sin(halfAngle), (T) cos(halfAngle));
+    }
+
+    static Quat FromAxisAngle(const Vec3<T>& axis, T angle, Precision precision)
+    {
+        float sint, cost;
+        SinCos((float) (angle / 2), &sint, &cost, precision);
+        return FromAxisAngle(axis, (T) sint, (T) cost);
+    }
+
+    // Takes sine and cosine of HALF the angle
+    static Quat FromAxisAngle(const Vec3<T>& axis, T sinHalf, T cosHalf)
+    {
+        Quat r;
+        r.x = axis.x * sinHalf;
+        r.y = axis.y * sinHalf;
+        r.z = axis.z * sinHalf;
+        r.w = cosHalf;
+
+        return r;
+    }
+
+    // Rotation part of a matrix without scale (Shepperd's method)
+    static Quat FromMat4x4(const Mat4x4<T>& matrix)
+    {
+        const T* m = matrix.m;
+        const T trace = m[0] + m[5] + m[10];
+        
+        Quat r;
+        if (trace > 0)
+        {
+            const T s = (T) sqrt(trace + 1) * 2;
+            r.w = s / 4;
+            r.x = (m[9] - m[6]) / s;
+            r.y = (m[2] - m[8]) / s;
+            r.z = (m[4] - m[1]) / s;
+        }
+        else if (m[0] > m[5] && m[0] > m[10])
+        {
+            const T s = (T) sqrt(1 + m[0] - m[5] - m[10]) * 2;
+            r.w = (m[9] - m[6]) / s;
+            r.x = s / 4;
+            r.y = (m[1] + m[4]) / s;
+            r.z = (m[2] + m[8]) / s;
+        }
+        else if (m[5] > m[10])
+        {
+            const T s = (T) sqrt(1 + m[5] - m[0] - m[10]) * 2;
+            r.w = (m[2] - m[8]) / s;
+            r.x = (m[1] + m[4]) / s;
+            r.y = s / 4;
+            r.z = (m[6] + m[9]) / s;
+        }
+        else
+        {
+            const T s = (T) sqrt(1 + m[10] - m[0] - m[5]) * 2;
+            r.w = (m[4] - m[1]) / s;
+            r.x = (m[2] + m[8]) / s;
+            r.y = (m[6] + m[9]) / s;
+            r.z = s / 4;
+        }
+        
+        return r;
+    }
+    
+    static T Dot(const Quat& q1, const Quat& q2)
+    {
+        return q1.x * q2.x + q1.y * q2.y + q1.z * q2.z + q1.w * q2.w;
+    }
+
+    T Length() const
+    {
+        return sqrt(Dot(*this, *this));
+    }
+
+    Quat Normalized() const
+    {
+        const T inverseLength = 1 / this->Length();
+        return Quat(x * inverseLength, y * inverseLength, z * inverseLength, w * inverseLength);
+    }
+
+    Quat Normalized(Precision precision) const
+    {
+        const T inverseLength = (T) RSqrt((float) Dot(*this, *this), precision);
+        return Quat(x * inverseLength, y * inverseLength, z * inverseLength, w * inverseLength);
+    }
+
+    // Inverse of a unit quaternion
+    Quat Conjugate() const
+    {
+        return Quat(-x, -y, -z, w);
+    }
+
+    // Normalized linear interpolation along the shortest arc. Not constant
+    // speed, but much cheaper than Slerp for small steps between keys.
+    static Quat Nlerp(const Quat& q1, const Quat& q2, T amount)
+    {
+        const T sign = Dot(q1, q2) < 0 ? -1 : 1;
+        const T diff = 1 - amount;
+
+        Quat r;
+        r.x = diff * q1.x + amount * sign * q2.x;
+        r.y = diff * q1.y + amount * sign * q2.y;
+        r.z = diff * q1.z + amount * sign * q2.z;
+        r.w = diff * q1.w + amount * sign * q2.w;
+
+        return r.Normalized();
+    }
+
+    // Spherical linear interpolation along the shortest arc
+    static Quat Slerp(const Quat& q1, const Quat& q2, T amount)
+    {
+        T cosTheta = Dot(q1, q2);
+        T sign = 1;
+        if (cosTheta < 0)
+        {
+            cosTheta = -cosTheta;
+            sign = -1;
+        }
+
+        // Nearly parallel: sin(theta) goes to zero, lerp is exact enough
+        if (cosTheta > (T) 0.9995)
+            return Nlerp(q1, q2, amount);
+
+        const T theta = (T) acos(cosTheta);
+        const T inverseSin = 1 / (T) sin(theta);
+        const T s1 = (T) sin((1 - amount) * theta) * inverseSin;
+        const T s2 = (T) sin(amount * theta) * inverseSin * sign;
+
+        Quat r;
+        r.x = s1 * q1.x + s2 * q2.x;
+        r.y = s1 * q1.y + s2 * q2.y;
+        r.z = s1 * q1.z + s2 * q2.z;
+        r.w = s1 * q1.w + s2 * q2.w;
+
+        return r;
+    }
+
+    // Rotation matrix of a unit quaternion, same layout as Mat4x4::Rotate*
+    Mat4x4<T> ToMat4x4() const
+    {
+        const T xx = x * x, yy = y * y, zz = z * z;
+        const T xy = x * y, xz = x * z, yz = y * z;
+        const T wx = w * x, wy = w * y, wz = w * z;
+
+        const T values[16] =
+        {
+            1 - 2 * (yy + zz),  2 * (xy - wz),      2 * (xz + wy),      0,
+            2 * (xy + wz),      1 - 2 * (xx + zz),  2 * (yz - wx),      0,
+            2 * (xz - wy),      2 * (yz + wx),      1 - 2 * (xx + yy),  0,
+            0,                  0,                  0,                  1,
+        };
+        Mat4x4<T> r;
+        r.Set(values);
+
+        return r;
+    }
+
+    // v' = v + 2w (q x v) + 2 q x (q x v)
+    Vec3<T> Rotate(const Vec3<T>& v) const
+    {
+        const Vec3<T> q(x, y, z);
+        const Vec3<T> t = Vec3<T>::Cross(q, v) * 2;
+
+        return v + t * w + Vec3<T>::Cross(q, t);
+    }
+
+    // Hamilton product: (q1 * q2) rotates by q2 first, then by q1
+    Quat operator*(const Quat& rhs) const
+    {
+        Quat r;
+        r.x = w * rhs.x + x * rhs.w + y * rhs.z - z * rhs.y;
+        r.y = w * rhs.y - x * rhs.z + y * rhs.w + z * rhs.x;
+        r.z = w * rhs.z + x * rhs.y - y * rhs.x + z * rhs.w;
+        r.w = w * rhs.w - x * rhs.x - y * rhs.y - z * rhs.z;
+
+        return r;
+    }
+
+    void operator*=(const Quat& rhs)
+    {
+        *this = (*this) * rhs;
+    }
+
+    bool operator==(const Quat& rhs) const
+    {
+        return this->x == rhs.x &&
+               this->y == rhs.y &&
+               this->z == rhs.z &&
+               this->w == rhs.w;
+    }
+
+    bool operator!=(const Quat& rhs) const
+    {
+        return !(*this == rhs);
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const Quat& q)
+    {
+        os << '[' << q.x
+           << ", " << q.y
+           << ", " << q.z
+           << ", " << q.w
+           << ']';
+
+       return os;
+    }
+};
+
+// Rotates count vectors stored as separate x, y and z arrays by one unit
+// quaternion. The quaternion is expanded to a 3x3 matrix once, after that
+// every vector costs 9 multiplies and streams through SSE registers.
+// The output arrays may alias the input arrays.
+inline void RotateVectors(const Quat<float>& q,
+                          const float* xs, const float* ys, const float* zs,
+                          float* outXs, float* outYs, float* outZs,
+                          const int count)
+{
+    const Mat4x4<float> m = q.ToMat4x4();
+
+    const __m128 m0 = _mm_set1_ps(m.m[0]), m1 = _mm_set1_ps(m.m[1]), m2 = _mm_set1_ps(m.m[2]);
+    const __m128 m4 = _mm_set1_ps(m.m[4]), m5 = _mm_set1_ps(m.m[5]), m6 = _mm_set1_ps(m.m[6]);
+    const __m128 m8 = _mm_set1_ps(m.m[8]), m9 = _mm_set1_ps(m.m[9]), m10 = _mm_set1_ps(m.m[10]);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(xs + i);
+        const __m128 y = _mm_loadu_ps(ys + i);
+        const __m128 z = _mm_loadu_ps(zs + i);
+
+        const __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, x), _mm_mul_ps(m1, y)), _mm_mul_ps(m2, z));
+        const __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m4, x), _mm_mul_ps(m5, y)), _mm_mul_ps(m6, z));
+        const __m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m8, x), _mm_mul_ps(m9, y)), _mm_mul_ps(m10, z));
+
+        _mm_storeu_ps(outXs + i, rx);
+        _mm_storeu_ps(outYs + i, ry);
+        _mm_storeu_ps(outZs + i, rz);
+    }
+
+    for (; i < count; ++i)
+    {
+        const float x = xs[i], y = ys[i], z = zs[i];
+        outXs[i] = m.m[0] * x + m.m[1] * y + m.m[2] * z;
+        outYs[i] = m.m[4] * x + m.m[5] * y + m.m[6] * z;
+        outZs[i] = m.m[8] * x + m.m[9] * y + m.m[10] * z;
+    }
+}
+
+inline void RotateVectors(const Quat<float>& q, float* xs, float* ys, float* zs, const int count)
+{
+    RotateVectors(q, xs, ys, zs, xs, ys, zs, count);
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+#include "fixed.h"
+
+// Vertices with subpixel precision
+struct Triangle
+{
+    Fixed28_4 x0;
+    Fixed28_4 y0;
+    Fixed28_4 x1;
+    Fixed28_4 y1;
+    Fixed28_4 x2;
+    Fixed28_4 y2;
+    
+    Triangle(Fixed28_4 x0 = 0, Fixed28_4 y0 = 0,
+             Fixed28_4 x1 = 0, Fixed28_4 y1 = 0,
+             Fixed28_4 x2 = 0, Fixed28_4 y2 = 0)
+        : x0(x0), y0(y0), x1(x1), y1(y1), x2(x2), y2(y2)
+    {}
+};
\ No newline at end of file
@@ -1,5 +1,11 @@
 #pragma once
 #include <cmath>
+#include <ostream>
+#include "fastmath.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
 
 template<typename T>
 struct Vec3
@@ -47,6 +53,18 @@ struct Vec3
         return r;
 	}
     
+    Vec3 Normalized(Precision precision) const
+    {
+		const T inverseLength = (T) RSqrt((float) this->LengthSquared(), precision);
+        
+        Vec3 r;
+        r.x = x * inverseLength;
+        r.y = y * inverseLength;
+        r.z = z * inverseLength;
+        
+        return r;
+	}
+    
     static T Distance(const Vec3& v1, const Vec3& v2)
     {
         return (v1 - v2).Length();
@@ -70,14 +88,25 @@ struct Vec3
     }
     
     Vec3 Rotated(const Vec3& axis, T angle)
+    {
+        const T t = angle * M_PI / 180;
+        return this->Rotated(axis, (T) sin(t), (T) cos(t));
+    }
+    
+    Vec3 Rotated(const Vec3& axis, T angle, Precision precision)
+    {
+        float sint, cost;
+        SinCos((float) (angle * M_PI / 180), &sint, &cost, precision);
+        return this->Rotated(axis, (T) sint, (T) cost);
+    }
+    
+    // Takes the sine and cosine of the angle precomputed, so rotating many
+    // vectors by the same angle evaluates them only once.
+    Vec3 Rotated(const Vec3& axis, T sint, T cost)
     {
         // Rodrigues' Rotation Formula
         // v(rot) = v cos(t) + (axis X v) sin(t) + axis ( axis . v ) (1 - cos(t))
 		// v(rot) = a + b + c
-        
-        const T t = angle * M_PI / 180;
-		const T sint = sin(t);
-		const T cost = cos(t);
 
 		// a = v cos(t)
 		const T ax = this->x * cost;
@@ -11,7 +11,7 @@ struct Vec4
         : x(x), y(y), z(z), w(w)
     {}
 	
-	Vec4(const Vec3& v)
+	Vec4(const Vec3<T>& v)
         : x(v.x), y(v.y), z(v.z), w(1)
     {}
 };
\ No newline at end of file
@@ -0,0 +1,543 @@
+#pragma once
+#include <vector>
+#include <cstring>
+#include <climits>
+#include <cstdio>
+#include <iostream>
+#include "math/vec3.h"
+#include "mapped_file.h"
+#include "vertex_cache.h"
+#include "kernels.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Binary mesh file, little endian. Every stream starts at a 16 byte
+// aligned offset, so a mapped file can be used in place.
+struct MeshFileHeader
+{
+    char            magic[4];       // "CG1M"
+    unsigned int    version;
+    unsigned int    vertexCount;
+    unsigned int    indexCount;
+    unsigned int    indexSize;      // 2 or 4 bytes
+    unsigned int    xOffset;        // Byte offsets of the streams from the start of the file
+    unsigned int    yOffset;
+    unsigned int    zOffset;
+    unsigned int    indexOffset;
+};
+
+// Indexed triangle mesh with positions in SoA layout. Either owns its data
+// (loaded from OBJ) or points into a memory mapped binary mesh file.
+class Mesh
+{
+private:
+    static const unsigned int FileVersion = 1;
+
+    const float*                xs;
+    const float*                ys;
+    const float*                zs;
+    const void*                 indices;
+    int                         vertexCount;
+    int                         indexCount;
+    int                         indexSize;
+
+    std::vector<float>          positionStorage;
+    std::vector<unsigned int>   indexStorage;
+    std::vector<unsigned short> shortIndexStorage;
+    MappedFile                  file;
+
+    Mesh(const Mesh&);
+    Mesh& operator=(const Mesh&);
+
+    struct ObjChunk
+    {
+        const char* begin;
+        const char* end;
+        int vertexCount;
+        int triangleCount;
+        int vertexOffset;
+        int triangleOffset;
+    };
+
+    static inline bool IsSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    static inline const char* SkipSpaces(const char* p, const char* end)
+    {
+        while (p < end && IsSpace(*p))
+            p++;
+        return p;
+    }
+
+    static inline const char* NextLine(const char* p, const char* end)
+    {
+        const char* newline = (const char*) memchr(p, '\n', end - p);
+        return newline ? newline + 1 : end;
+    }
+
+    static inline bool IsDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    static const char* ParseInt(const char* p, const char* end, int* value)
+    {
+        bool isNegative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            isNegative = (*p++ == '-');
+
+        int r = 0;
+        while (p < end && IsDigit(*p))
+            r = r * 10 + (*p++ - '0');
+
+        *value = isNegative ? -r : r;
+        return p;
+    }
+
+    // Locale independent and much faster than strtof, exact enough for
+    // the 6-7 significant digits exporters write
+    static const char* ParseFloat(const char* p, const char* end, float* value)
+    {
+        static const double powers[] =
+        {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+            1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+        };
+
+        bool isNegative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            isNegative = (*p++ == '-');
+
+        double mantissa = 0;
+        int exponent = 0;
+        while (p < end && IsDigit(*p))
+            mantissa = mantissa * 10 + (*p++ - '0');
+
+        if (p < end && *p == '.')
+        {
+            p++;
+            while (p < end && IsDigit(*p))
+            {
+                mantissa = mantissa * 10 + (*p++ - '0');
+                exponent--;
+            }
+        }
+
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            int e;
+            p = ParseInt(p + 1, end, &e);
+            exponent += e;
+        }
+
+        double r = mantissa;
+        while (exponent < -18)
+        {
+            r /= powers[18];
+            exponent += 18;
+        }
+        while (exponent > 18)
+        {
+            r *= powers[18];
+            exponent -= 18;
+        }
+        r = exponent < 0 ? r / powers[-exponent] : r * powers[exponent];
+
+        *value = (float) (isNegative ? -r : r);
+        return p;
+    }
+
+    // Pass 1: how many vertices and triangles are in a chunk
+    static void CountObjChunk(ObjChunk* chunk)
+    {
+        const char* p = chunk->begin;
+        const char* end = chunk->end;
+        chunk->vertexCount = 0;
+        chunk->triangleCount = 0;
+
+        while (p < end)
+        {
+            p = SkipSpaces(p, end);
+            if (end - p > 1 && p[0] == 'v' && IsSpace(p[1]))
+            {
+                chunk->vertexCount++;
+            }
+            else if (end - p > 1 && p[0] == 'f' && IsSpace(p[1]))
+            {
+                const char* lineEnd = NextLine(p, end);
+                int corners = 0;
+                for (const char* q = p + 1; q < lineEnd; )
+                {
+                    q = SkipSpaces(q, lineEnd);
+                    if (q >= lineEnd || *q == '\n')
+                        break;
+                    corners++;
+                    while (q < lineEnd && !IsSpace(*q) && *q != '\n')
+                        q++;
+                }
+                if (corners >= 3)
+                    chunk->triangleCount += corners - 2;
+                p = lineEnd;
+                continue;
+            }
+
+            p = NextLine(p, end);
+        }
+    }
+
+    // Pass 2: parse a chunk into its slice of the output arrays. Faces are
+    // triangulated as fans; only the position index of v/vt/vn is used.
+    static void ParseObjChunk(const ObjChunk& chunk, float* xs, float* ys, float* zs, unsigned int* indices)
+    {
+        const char* p = chunk.begin;
+        const char* end = chunk.end;
+        int vertex = chunk.vertexOffset;
+        unsigned int* triangle = indices + chunk.triangleOffset * 3;
+
+        while (p < end)
+        {
+            p = SkipSpaces(p, end);
+            if (end - p > 1 && p[0] == 'v' && IsSpace(p[1]))
+            {
+                p = ParseFloat(SkipSpaces(p + 1, end), end, &xs[vertex]);
+                p = ParseFloat(SkipSpaces(p, end), end, &ys[vertex]);
+                p = ParseFloat(SkipSpaces(p, end), end, &zs[vertex]);
+                vertex++;
+            }
+            else if (end - p > 1 && p[0] == 'f' && IsSpace(p[1]))
+            {
+                const char* lineEnd = NextLine(p, end);
+                unsigned int first = 0, previous = 0;
+                int corners = 0;
+                for (const char* q = p + 1; q < lineEnd; )
+                {
+                    q = SkipSpaces(q, lineEnd);
+                    if (q >= lineEnd || *q == '\n')
+                        break;
+
+                    // Negative indices are relative to the vertices so far
+                    int index;
+                    q = ParseInt(q, lineEnd, &index);
+                    const unsigned int corner = (unsigned int) (index < 0 ? vertex + index : index - 1);
+                    while (q < lineEnd && !IsSpace(*q) && *q != '\n')
+                        q++;
+
+                    if (corners == 0)
+                        first = corner;
+                    else if (corners >= 2)
+                    {
+                        triangle[0] = first;
+                        triangle[1] = previous;
+                        triangle[2] = corner;
+                        triangle += 3;
+                    }
+                    previous = corner;
+                    corners++;
+                }
+                p = lineEnd;
+                continue;
+            }
+
+            p = NextLine(p, end);
+        }
+    }
+
+    void UseStorage()
+    {
+        this->xs = this->positionStorage.data();
+        this->ys = this->xs + this->vertexCount;
+        this->zs = this->ys + this->vertexCount;
+        if (this->indexSize == 2)
+            this->indices = this->shortIndexStorage.data();
+        else
+            this->indices = this->indexStorage.data();
+    }
+
+public:
+    Mesh()
+        : xs(nullptr), ys(nullptr), zs(nullptr), indices(nullptr),
+          vertexCount(0), indexCount(0), indexSize(4)
+    {
+    }
+
+    inline int GetVertexCount() const { return this->vertexCount; }
+    inline int GetIndexCount() const { return this->indexCount; }
+    inline int GetTriangleCount() const { return this->indexCount / 3; }
+    inline int GetIndexSize() const { return this->indexSize; }
+    inline const float* GetX() const { return this->xs; }
+    inline const float* GetY() const { return this->ys; }
+    inline const float* GetZ() const { return this->zs; }
+    inline const void* GetIndices() const { return this->indices; }
+
+    inline unsigned int GetIndex(int i) const
+    {
+        if (this->indexSize == 2)
+            return ((const unsigned short*) this->indices)[i];
+        return ((const unsigned int*) this->indices)[i];
+    }
+
+    inline Vec3<float> GetPosition(int vertex) const
+    {
+        return Vec3<float>(this->xs[vertex], this->ys[vertex], this->zs[vertex]);
+    }
+
+    // Transforms the corners of all triangles (GetIndexCount() entries),
+    // every shared vertex is transformed once while it stays in the cache
+    void TransformTriangles(const Mat4x4<float>& matrix, PostTransformCache* cache, Vec4<float>* corners) const
+    {
+        cache->TransformTriangles(matrix, this->xs, this->ys, this->zs,
+                                  this->indices, this->indexSize, this->indexCount, corners);
+    }
+    
+    // Transforms every vertex (GetVertexCount() entries), for meshes drawn
+    // without an index buffer or with most vertices visible
+    void TransformVertices(const Mat4x4<float>& matrix, Vec4<float>* out) const
+    {
+        GetKernels().transformVertices(matrix, this->xs, this->ys, this->zs, out, this->vertexCount);
+    }
+    
+    // Replaces the mesh with owned copies of the given streams
+    void Set(const float* xs, const float* ys, const float* zs, int vertexCount,
+             const unsigned int* indices, int indexCount)
+    {
+        this->file.Close();
+        this->vertexCount = vertexCount;
+        this->indexCount = indexCount;
+        this->indexSize = vertexCount <= 0xFFFF ? 2 : 4;
+
+        this->positionStorage.resize(vertexCount * 3);
+        std::copy(xs, xs + vertexCount, this->positionStorage.begin());
+        std::copy(ys, ys + vertexCount, this->positionStorage.begin() + vertexCount);
+        std::copy(zs, zs + vertexCount, this->positionStorage.begin() + vertexCount * 2);
+
+        if (this->indexSize == 2)
+        {
+            this->shortIndexStorage.assign(indices, indices + indexCount);
+            this->indexStorage.clear();
+        }
+        else
+        {
+            this->indexStorage.assign(indices, indices + indexCount);
+            this->shortIndexStorage.clear();
+        }
+
+        this->UseStorage();
+    }
+
+    // Parses the v and f lines of a Wavefront OBJ file. The mapped file is
+    // split into chunks at line breaks; the chunks are counted in parallel,
+    // a prefix sum gives each its output slice, then they are parsed in
+    // parallel straight into the final arrays.
+    //
+    // By default triangles are then reordered for the post-transform cache
+    // and vertices renumbered in order of first use, so a binary file saved
+    // afterwards carries the optimized order.
+    bool LoadObj(const char* path, bool isCacheOptimized = true)
+    {
+        MappedFile objFile;
+        if (!objFile.Open(path) || !objFile.IsOpen())
+            return false;
+
+        const char* text = (const char*) objFile.GetData();
+        const char* textEnd = text + objFile.GetSize();
+
+#ifdef _OPENMP
+        const int targetChunkCount = omp_get_max_threads() * 4;
+#else
+        const int targetChunkCount = 1;
+#endif
+        const size_t chunkSize = objFile.GetSize() / targetChunkCount + 1;
+        std::vector<ObjChunk> chunks;
+        for (const char* p = text; p < textEnd; )
+        {
+            ObjChunk chunk;
+            chunk.begin = p;
+            chunk.end = (size_t) (textEnd - p) > chunkSize ? NextLine(p + chunkSize, textEnd) : textEnd;
+            chunks.push_back(chunk);
+            p = chunk.end;
+        }
+
+        const int chunkCount = (int) chunks.size();
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (int i = 0; i < chunkCount; ++i)
+            CountObjChunk(&chunks[i]);
+
+        int vertexCount = 0, triangleCount = 0;
+        for (int i = 0; i < chunkCount; ++i)
+        {
+            chunks[i].vertexOffset = vertexCount;
+            chunks[i].triangleOffset = triangleCount;
+            vertexCount += chunks[i].vertexCount;
+            triangleCount += chunks[i].triangleCount;
+        }
+
+        std::vector<float> positions(vertexCount * 3);
+        std::vector<unsigned int> indices(triangleCount * 3);
+        float* xs = positions.data();
+        float* ys = xs + vertexCount;
+        float* zs = ys + vertexCount;
+
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (int i = 0; i < chunkCount; ++i)
+            ParseObjChunk(chunks[i], xs, ys, zs, indices.data());
+
+        for (int i = 0; i < triangleCount * 3; ++i)
+        {
+            if (indices[i] >= (unsigned int) vertexCount)
+            {
+                std::cout << "Invalid face index in: " << path << std::endl;
+                return false;
+            }
+        }
+
+        if (isCacheOptimized)
+        {
+            OptimizeVertexCache(indices.data(), triangleCount * 3, vertexCount);
+
+            std::vector<int> remap;
+            const int usedCount = OptimizeVertexFetch(indices.data(), triangleCount * 3, vertexCount, &remap);
+            std::vector<float> reordered(usedCount * 3);
+            for (int v = 0; v < vertexCount; ++v)
+            {
+                const int r = remap[v];
+                if (r < 0)
+                    continue;
+                reordered[r] = xs[v];
+                reordered[usedCount + r] = ys[v];
+                reordered[usedCount * 2 + r] = zs[v];
+            }
+            positions.swap(reordered);
+            vertexCount = usedCount;
+        }
+
+        this->file.Close();
+        this->vertexCount = vertexCount;
+        this->indexCount = triangleCount * 3;
+        this->indexSize = vertexCount <= 0xFFFF ? 2 : 4;
+        this->positionStorage.swap(positions);
+        if (this->indexSize == 2)
+        {
+            this->shortIndexStorage.assign(indices.begin(), indices.end());
+            this->indexStorage.clear();
+        }
+        else
+        {
+            this->indexStorage.swap(indices);
+            this->shortIndexStorage.clear();
+        }
+        this->UseStorage();
+
+        return true;
+    }
+
+    // Maps a binary mesh file and points the streams into it, no parsing
+    // and no copies. The file stays mapped as long as the mesh lives.
+    bool LoadBinary(const char* path)
+    {
+        this->positionStorage.clear();
+        this->indexStorage.clear();
+        this->shortIndexStorage.clear();
+        this->vertexCount = 0;
+        this->indexCount = 0;
+
+        if (!this->file.Open(path) || !this->file.IsOpen())
+            return false;
+
+        const unsigned char* data = this->file.GetData();
+        const size_t size = this->file.GetSize();
+        MeshFileHeader header;
+        if (size < sizeof(header))
+        {
+            std::cout << "Invalid mesh file: " << path << std::endl;
+            this->file.Close();
+            return false;
+        }
+        memcpy(&header, data, sizeof(header));
+
+        // Counts have to fit the int members and the streams are used in
+        // place, so they must be aligned to their element size
+        const unsigned long long positionBytes = (unsigned long long) header.vertexCount * sizeof(float);
+        const unsigned long long indexBytes = (unsigned long long) header.indexCount * header.indexSize;
+        if (memcmp(header.magic, "CG1M", 4) != 0 || header.version != FileVersion ||
+            (header.indexSize != 2 && header.indexSize != 4) ||
+            header.vertexCount > INT_MAX || header.indexCount > INT_MAX ||
+            (header.xOffset | header.yOffset | header.zOffset) % sizeof(float) != 0 ||
+            header.indexOffset % header.indexSize != 0 ||
+            header.xOffset + positionBytes > size || header.yOffset + positionBytes > size ||
+            header.zOffset + positionBytes > size || header.indexOffset + indexBytes > size)
+        {
+            std::cout << "Invalid mesh file: " << path << std::endl;
+            this->file.Close();
+            return false;
+        }
+
+        // Out of range indices would make the transforms read past the streams
+        const unsigned char* indices = data + header.indexOffset;
+        for (unsigned int i = 0; i < header.indexCount; ++i)
+        {
+            const unsigned int index = header.indexSize == 2 ? ((const unsigned short*) indices)[i]
+                                                             : ((const unsigned int*) indices)[i];
+            if (index >= header.vertexCount)
+            {
+                std::cout << "Invalid face index in: " << path << std::endl;
+                this->file.Close();
+                return false;
+            }
+        }
+
+        this->vertexCount = (int) header.vertexCount;
+        this->indexCount = (int) header.indexCount;
+        this->indexSize = (int) header.indexSize;
+        this->xs = (const float*) (data + header.xOffset);
+        this->ys = (const float*) (data + header.yOffset);
+        this->zs = (const float*) (data + header.zOffset);
+        this->indices = indices;
+
+        return true;
+    }
+
+    bool SaveBinary(const char* path) const
+    {
+        FILE* out = fopen(path, "wb");
+        if (!out)
+        {
+            std::cout << "Could not write mesh file: " << path << std::endl;
+            return false;
+        }
+
+        const unsigned int positionBytes = this->vertexCount * sizeof(float);
+        const unsigned int alignedPositionBytes = (positionBytes + 15) & ~15u;
+
+        MeshFileHeader header;
+        memcpy(header.magic, "CG1M", 4);
+        header.version = FileVersion;
+        header.vertexCount = this->vertexCount;
+        header.indexCount = this->indexCount;
+        header.indexSize = this->indexSize;
+        header.xOffset = (sizeof(header) + 15) & ~15u;
+        header.yOffset = header.xOffset + alignedPositionBytes;
+        header.zOffset = header.yOffset + alignedPositionBytes;
+        header.indexOffset = header.zOffset + alignedPositionBytes;
+
+        const unsigned char padding[16] = { 0 };
+        bool isOk = fwrite(&header, sizeof(header), 1, out) == 1;
+        isOk = isOk && fwrite(padding, header.xOffset - sizeof(header), 1, out) <= 1;
+        const float* streams[3] = { this->xs, this->ys, this->zs };
+        for (int i = 0; i < 3 && isOk; ++i)
+        {
+            isOk = fwrite(streams[i], sizeof(float), this->vertexCount, out) == (size_t) this->vertexCount;
+            isOk = isOk && fwrite(padding, alignedPositionBytes - positionBytes, 1, out) <= 1;
+        }
+        isOk = isOk && fwrite(this->indices, this->indexSize, this->indexCount, out) == (size_t) this->indexCount;
+
+        fclose(out);
+        if (!isOk)
+            std::cout << "Could not write mesh file: " << path << std::endl;
+
+        return isOk;
+    }
+};
\ No newline at end of file
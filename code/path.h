@@ -0,0 +1,245 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <emmintrin.h>
+#include "math/vec2.h"
+#include "bezier.h"
+#include "kernels.h"
+
+// Vector path of closed contours. Curves are flattened as they are added,
+// so filling only sees lines.
+class Path
+{
+private:
+    std::vector<Vec2<float> >   points;
+    std::vector<int>            contours;   // First point of every contour
+    float                       tolerance;
+    
+public:
+    // tolerance: how far (in pixels) the flattened curves may be off
+    Path(const float tolerance = 0.2f)
+        : tolerance(tolerance)
+    {
+    }
+    
+    void MoveTo(const float x, const float y)
+    {
+        this->contours.push_back((int) this->points.size());
+        this->points.push_back(Vec2<float>(x, y));
+    }
+    
+    void LineTo(const float x, const float y)
+    {
+        if (this->contours.empty())
+            this->contours.push_back(0);
+        this->points.push_back(Vec2<float>(x, y));
+    }
+    
+    void QuadTo(const float cx, const float cy, const float x, const float y)
+    {
+        if (this->points.empty())
+            this->MoveTo(cx, cy);
+        const QuadraticBezier curve = { this->points.back(), Vec2<float>(cx, cy), Vec2<float>(x, y) };
+        TessellateBezier(curve, this->tolerance, &this->points);
+    }
+    
+    void CubicTo(const float c1x, const float c1y, const float c2x, const float c2y, const float x, const float y)
+    {
+        if (this->points.empty())
+            this->MoveTo(c1x, c1y);
+        const CubicBezier curve = { this->points.back(), Vec2<float>(c1x, c1y), Vec2<float>(c2x, c2y), Vec2<float>(x, y) };
+        TessellateBezier(curve, this->tolerance, &this->points);
+    }
+    
+    void Clear()
+    {
+        this->points.clear();
+        this->contours.clear();
+    }
+    
+    inline const std::vector<Vec2<float> >& GetPoints() const { return this->points; }
+    inline int GetContourCount() const { return (int) this->contours.size(); }
+    inline int GetContourBegin(const int contour) const { return this->contours[contour]; }
+    
+    inline int GetContourEnd(const int contour) const
+    {
+        return contour + 1 < (int) this->contours.size() ? this->contours[contour + 1] : (int) this->points.size();
+    }
+};
+
+// Signed area accumulation of an anti-aliased fill. Every edge adds the
+// area it covers to the right of itself, signed by direction, to the
+// cells it crosses; the running sum along a row is then the coverage of
+// each pixel (nonzero rule, saturated). One pass, no supersampling.
+class CoverageBuffer
+{
+private:
+    std::vector<float>  cells;
+    int                 width;
+    int                 height;
+    int                 stride;     // Room for the cells right of the last pixel
+    
+    // Edge with both ends inside [0, width] horizontally
+    void AccumulateLine(const float x0, const float y0, const float x1, const float y1)
+    {
+        if (y0 == y1)
+            return;
+        
+        // Downwards, the direction goes into the sign
+        const float dir = y0 < y1 ? 1.0f : -1.0f;
+        const float top = std::min(y0, y1), bottom = std::max(y0, y1);
+        const float xTop = y0 < y1 ? x0 : x1;
+        const float dxdy = (x1 - x0) / (y1 - y0);
+        const int yBegin = std::max((int) floorf(top), 0);
+        const int yEnd = std::min((int) ceilf(bottom), this->height);
+        float x = yBegin > top ? std::min(std::max(xTop + (yBegin - top) * dxdy, 0.0f), (float) this->width) : xTop;
+        
+        for (int y = yBegin; y < yEnd; ++y)
+        {
+            float* row = this->cells.data() + y * this->stride;
+            const float dy = std::min((float) (y + 1), bottom) - std::max((float) y, top);
+            // Stepping may drift past the ends, which are inside the buffer
+            const float xNext = std::min(std::max(x + dxdy * dy, 0.0f), (float) this->width);
+            const float d = dy * dir;
+            const float left = std::min(x, xNext), right = std::max(x, xNext);
+            const float leftFloor = floorf(left);
+            const int leftCell = (int) leftFloor;
+            const int rightCell = (int) ceilf(right);
+            
+            if (rightCell <= leftCell + 1)
+            {
+                // Within one pixel: split by the mean x
+                const float xMid = 0.5f * (x + xNext) - leftFloor;
+                row[leftCell] += d - d * xMid;
+                row[leftCell + 1] += d * xMid;
+            }
+            else
+            {
+                // The covered area grows linearly between the first and
+                // last pixel and quadratically inside them
+                const float s = 1.0f / (right - left);
+                const float leftFraction = left - leftFloor;
+                const float leftArea = 0.5f * s * (1 - leftFraction) * (1 - leftFraction);
+                const float rightFraction = right - rightCell + 1;
+                const float rightArea = 0.5f * s * rightFraction * rightFraction;
+                row[leftCell] += d * leftArea;
+                if (rightCell == leftCell + 2)
+                {
+                    row[leftCell + 1] += d * (1 - leftArea - rightArea);
+                }
+                else
+                {
+                    const float area = s * (1.5f - leftFraction);
+                    row[leftCell + 1] += d * (area - leftArea);
+                    for (int cell = leftCell + 2; cell < rightCell - 1; ++cell)
+                        row[cell] += d * s;
+                    const float lastArea = area + (rightCell - leftCell - 3) * s;
+                    row[rightCell - 1] += d * (1 - lastArea - rightArea);
+                }
+                row[rightCell] += d * rightArea;
+            }
+            x = xNext;
+        }
+    }
+    
+public:
+    CoverageBuffer()
+        : width(0), height(0), stride(0)
+    {
+    }
+    
+    // Clears a buffer of width x height pixels
+    void Reset(const int width, const int height)
+    {
+        this->width = width;
+        this->height = height;
+        this->stride = (width + 2 + 3) & ~3;
+        this->cells.assign(this->stride * height, 0.0f);
+    }
+    
+    inline int GetWidth() const { return this->width; }
+    inline int GetHeight() const { return this->height; }
+    
+    // Edge in pixel coordinates of the buffer, pixel (x, y) covers
+    // [x, x + 1) x [y, y + 1). Parts left or right of the buffer still
+    // count, they run along its border.
+    void AddLine(const float x0, const float y0, const float x1, const float y1)
+    {
+        if (y0 == y1)
+            return;
+        
+        // Split where the edge crosses either border, then clamp
+        float ts[4] = { 0.0f, 1.0f, 1.0f, 1.0f };
+        int count = 1;
+        const float borders[2] = { 0.0f, (float) this->width };
+        for (int k = 0; k < 2; ++k)
+        {
+            const float t = (borders[k] - x0) / (x1 - x0);
+            if (t > 0.0f && t < 1.0f)
+                ts[count++] = t;
+        }
+        ts[count++] = 1.0f;
+        std::sort(ts, ts + count);
+        
+        const float maxX = (float) this->width;
+        float px = std::min(std::max(x0, 0.0f), maxX), py = y0;
+        for (int k = 1; k < count; ++k)
+        {
+            const float nx = std::min(std::max(x0 + (x1 - x0) * ts[k], 0.0f), maxX);
+            const float ny = k == count - 1 ? y1 : y0 + (y1 - y0) * ts[k];
+            this->AccumulateLine(px, py, nx, ny);
+            px = nx;
+            py = ny;
+        }
+    }
+    
+    // Blends color (premultiplied ARGB8888) scaled by the coverage of every
+    // pixel into the buffer rows at (x, y) through blendSpan, and clears the
+    // accumulation for the next fill. The running sum is an SSE prefix sum
+    // of 4 cells at a time, the scaled colors go into the cells just read.
+    void Resolve(unsigned char* pixels, const int pitch, const int x, const int y, const unsigned int color,
+                 void (*blendSpan)(unsigned int*, const unsigned int*, int))
+    {
+        const __m128 scale = _mm_set_ps((float) (color >> 24), (float) ((color >> 16) & 0xFF),
+                                        (float) ((color >> 8) & 0xFF), (float) (color & 0xFF));
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 half = _mm_set1_ps(0.5f);
+        const int rows = this->height;
+        const int width = this->width;
+        
+        #pragma omp parallel for if (rows * width > 65536)
+        for (int row = 0; row < rows; ++row)
+        {
+            float* cells = this->cells.data() + row * this->stride;
+            __m128 carry = _mm_setzero_ps();
+            for (int i = 0; i < width; i += 4)
+            {
+                // Inclusive prefix sum of 4 plus everything before
+                __m128 sum = _mm_loadu_ps(cells + i);
+                sum = _mm_add_ps(sum, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(sum), 4)));
+                sum = _mm_add_ps(sum, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(sum), 8)));
+                sum = _mm_add_ps(sum, carry);
+                carry = _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(3, 3, 3, 3));
+                
+                const __m128 coverage = _mm_min_ps(_mm_andnot_ps(signMask, sum), one);
+                const __m128i argb[4] =
+                {
+                    _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(scale, _mm_shuffle_ps(coverage, coverage, 0x00)), half)),
+                    _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(scale, _mm_shuffle_ps(coverage, coverage, 0x55)), half)),
+                    _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(scale, _mm_shuffle_ps(coverage, coverage, 0xAA)), half)),
+                    _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(scale, _mm_shuffle_ps(coverage, coverage, 0xFF)), half)),
+                };
+                
+                // 32 bit channels to 8 bit, ARGB order by the lane order
+                const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(argb[0], argb[1]),
+                                                        _mm_packs_epi32(argb[2], argb[3]));
+                _mm_storeu_si128((__m128i*) (cells + i), packed);
+            }
+            
+            blendSpan((unsigned int*) (pixels + (y + row) * pitch) + x, (const unsigned int*) cells, width);
+            std::fill(cells, cells + this->stride, 0.0f);
+        }
+    }
+};
\ No newline at end of file
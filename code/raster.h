@@ -0,0 +1,594 @@
+#pragma once
+#include <algorithm>
+#include <emmintrin.h>
+#include "math/vec4.h"
+#include "math/fixed.h"
+#include "clip.h"
+#include "triangle_setup.h"
+#include "texture.h"
+#include "kernels.h"
+
+// Vertex as it enters triangle setup: position in screen space (see
+// ProjectToScreen, w holds 1 / w(clip)) and the attributes to interpolate,
+// e.g. color, UV and normal. Attributes are interpolated perspective
+// correct, depth (z) linearly in screen space.
+struct RasterVertex
+{
+    static const int MaxVaryings = 12;
+
+    Vec4<float>     position;
+    float           varyings[MaxVaryings];
+};
+
+enum class PixelFormat
+{
+    Argb8888,   // BGRA in memory, the backbuffer format
+    Rgb565,
+    Count,
+};
+
+// What the rasterizer draws into, pixels in the given format and an
+// optional float depth buffer of width * height
+struct RenderTarget
+{
+    unsigned char*  pixels;
+    float*          depth;
+    PixelFormat     format;
+    int             width;
+    int             height;
+    int             pitch;
+};
+
+// value(x, y) = origin + dx * (x - minX) + dy * (y - minY)
+struct Interpolant
+{
+    float   origin;
+    float   dx;
+    float   dy;
+};
+
+// Everything the inner loop needs, computed once per triangle
+struct TriangleSetup
+{
+    int             minX, minY, maxX, maxY;
+    int             edges[3];       // Edge functions at (minX, minY), 28.4
+    int             edgeStepX[3];
+    int             edgeStepY[3];
+    Interpolant     depth;
+    Interpolant     inverseW;
+    Interpolant     varyings[RasterVertex::MaxVaryings];    // a / w
+    int             varyingCount;
+};
+
+// Plane equation of f through 3 vertices, relative to vertex 0 (x10 is
+// x1 - x0 and so on) and evaluated from (originX, originY) in that frame
+inline Interpolant MakeInterpolant(const float f0, const float f1, const float f2,
+                                   const float x10, const float y10, const float x20, const float y20,
+                                   const float inverseArea, const float originX, const float originY)
+{
+    Interpolant result;
+    result.dx = ((f1 - f0) * y20 - (f2 - f0) * y10) * inverseArea;
+    result.dy = ((f2 - f0) * x10 - (f1 - f0) * x20) * inverseArea;
+    result.origin = f0 + result.dx * originX + result.dy * originY;
+    return result;
+}
+
+// Guard band around the target center in pixels. Triangles inside it are
+// only clipped by their bounding box at setup, only the ones reaching out
+// of it (or behind the near plane) are clipped as polygons.
+const float GuardBand = 1000.0f;
+const int MaxClippedVertices = 8;    // 3 + one per clip plane
+
+enum ClipPlane
+{
+    ClipNear    = 1,    // z >= -w
+    ClipLeft    = 2,    // x >= -band * w
+    ClipRight   = 4,    // x <= band * w
+    ClipBottom  = 8,    // y >= -band * w
+    ClipTop     = 16,   // y <= band * w
+};
+
+// Signed distance of a clip space position to plane, inside is >= 0.
+// bandX and bandY are the guard band in NDC units.
+inline float ClipDistance(const Vec4<float>& p, const int plane, const float bandX, const float bandY)
+{
+    switch (plane)
+    {
+        case ClipNear:      return p.z + p.w;
+        case ClipLeft:      return p.x + bandX * p.w;
+        case ClipRight:     return bandX * p.w - p.x;
+        case ClipBottom:    return p.y + bandY * p.w;
+        default:            return bandY * p.w - p.y;
+    }
+}
+
+// The ClipPlane bits a clip space position is outside of
+inline int ClipOutcode(const Vec4<float>& p, const float bandX, const float bandY)
+{
+    int code = 0;
+    for (int plane = ClipNear; plane <= ClipTop; plane <<= 1)
+        code |= ClipDistance(p, plane, bandX, bandY) < 0 ? plane : 0;
+    return code;
+}
+
+// Sutherland-Hodgman clipping of a clip space triangle against the given
+// ClipPlane bits. Positions and varyings are interpolated linearly in clip
+// space, so the result still interpolates perspective correct. Writes the
+// convex polygon to out (MaxClippedVertices) in the same winding and
+// returns its vertex count, less than 3 if nothing is left.
+inline int ClipTriangle(const RasterVertex& v0, const RasterVertex& v1, const RasterVertex& v2,
+                        const int varyingCount, const int planes, const float bandX, const float bandY,
+                        RasterVertex* out)
+{
+    RasterVertex buffer[MaxClippedVertices];
+    RasterVertex* input = out;
+    RasterVertex* output = buffer;
+    input[0] = v0;
+    input[1] = v1;
+    input[2] = v2;
+    int count = 3;
+    
+    for (int plane = ClipNear; plane <= ClipTop; plane <<= 1)
+    {
+        if (!(planes & plane))
+            continue;
+        
+        int outCount = 0;
+        for (int i = 0; i < count; ++i)
+        {
+            const RasterVertex& a = input[i];
+            const RasterVertex& b = input[(i + 1) % count];
+            const float da = ClipDistance(a.position, plane, bandX, bandY);
+            const float db = ClipDistance(b.position, plane, bandX, bandY);
+            if (da >= 0)
+                output[outCount++] = a;
+            if ((da >= 0) != (db >= 0))
+            {
+                const float t = da / (da - db);
+                RasterVertex& v = output[outCount++];
+                v.position.x = a.position.x + (b.position.x - a.position.x) * t;
+                v.position.y = a.position.y + (b.position.y - a.position.y) * t;
+                v.position.z = a.position.z + (b.position.z - a.position.z) * t;
+                v.position.w = a.position.w + (b.position.w - a.position.w) * t;
+                for (int k = 0; k < varyingCount; ++k)
+                    v.varyings[k] = a.varyings[k] + (b.varyings[k] - a.varyings[k]) * t;
+            }
+        }
+        
+        count = outCount;
+        std::swap(input, output);
+        if (count < 3)
+            return 0;
+    }
+    
+    // Every pass swaps the buffers
+    if (input != out)
+        std::copy(input, input + count, out);
+    return count;
+}
+
+// Snaps the vertices to 28.4, clips the bounding box to the clip rect and
+// sets up the edge functions and plane equations. Returns false if the
+// triangle covers no pixel. Like SDLRenderer::FillTriangle, vertices must
+// lie within +-1024 pixels of the target center (see ClipTriangle) and the
+// top-left fill rule applies.
+inline bool SetupTriangle(const RasterVertex& v0, const RasterVertex& v1, const RasterVertex& v2,
+                          const int varyingCount, const ClipRect& clip, TriangleSetup* setup)
+{
+    const RasterVertex* vertices[3] = { &v0, &v1, &v2 };
+    int xs[3], ys[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        xs[i] = Fixed28_4::FromFloat(vertices[i]->position.x).raw;
+        ys[i] = Fixed28_4::FromFloat(vertices[i]->position.y).raw;
+    }
+
+    // Make the winding clockwise on screen, so inside is positive
+    const long long area = (long long) (xs[1] - xs[0]) * (ys[2] - ys[0])
+                         - (long long) (ys[1] - ys[0]) * (xs[2] - xs[0]);
+    if (area == 0)
+        return false;
+    if (area < 0)
+    {
+        std::swap(xs[1], xs[2]);
+        std::swap(ys[1], ys[2]);
+        std::swap(vertices[1], vertices[2]);
+    }
+
+    setup->minX = std::max(Fixed28_4::FromRaw(std::min(xs[0], std::min(xs[1], xs[2]))).Ceil(), clip.minX);
+    setup->minY = std::max(Fixed28_4::FromRaw(std::min(ys[0], std::min(ys[1], ys[2]))).Ceil(), clip.minY);
+    setup->maxX = std::min(Fixed28_4::FromRaw(std::max(xs[0], std::max(xs[1], xs[2]))).Floor(), clip.maxX);
+    setup->maxY = std::min(Fixed28_4::FromRaw(std::max(ys[0], std::max(ys[1], ys[2]))).Floor(), clip.maxY);
+    if (setup->minX > setup->maxX || setup->minY > setup->maxY)
+        return false;
+
+    const int px = setup->minX * Fixed28_4::One;
+    const int py = setup->minY * Fixed28_4::One;
+    for (int i = 0; i < 3; ++i)
+    {
+        const int j = (i + 1) % 3;
+        const int dx = xs[j] - xs[i];
+        const int dy = ys[j] - ys[i];
+        const bool isTopLeft = (dy == 0 && dx > 0) || dy < 0;
+        setup->edges[i] = (int) ((long long) dx * (py - ys[i]) - (long long) dy * (px - xs[i]))
+                        - (isTopLeft ? 0 : 1);
+        setup->edgeStepX[i] = -dy * Fixed28_4::One;
+        setup->edgeStepY[i] = dx * Fixed28_4::One;
+    }
+
+    // Plane equations through the snapped vertices
+    const float x0 = xs[0] * (1.0f / Fixed28_4::One), y0 = ys[0] * (1.0f / Fixed28_4::One);
+    const float x10 = (xs[1] - xs[0]) * (1.0f / Fixed28_4::One), y10 = (ys[1] - ys[0]) * (1.0f / Fixed28_4::One);
+    const float x20 = (xs[2] - xs[0]) * (1.0f / Fixed28_4::One), y20 = (ys[2] - ys[0]) * (1.0f / Fixed28_4::One);
+    const float inverseArea = 1.0f / (x10 * y20 - x20 * y10);
+    const float originX = setup->minX - x0;
+    const float originY = setup->minY - y0;
+
+    const Vec4<float>& p0 = vertices[0]->position;
+    const Vec4<float>& p1 = vertices[1]->position;
+    const Vec4<float>& p2 = vertices[2]->position;
+    setup->depth = MakeInterpolant(p0.z, p1.z, p2.z, x10, y10, x20, y20, inverseArea, originX, originY);
+    setup->inverseW = MakeInterpolant(p0.w, p1.w, p2.w, x10, y10, x20, y20, inverseArea, originX, originY);
+    setup->varyingCount = varyingCount;
+    for (int k = 0; k < varyingCount; ++k)
+    {
+        setup->varyings[k] = MakeInterpolant(vertices[0]->varyings[k] * p0.w,
+                                             vertices[1]->varyings[k] * p1.w,
+                                             vertices[2]->varyings[k] * p2.w,
+                                             x10, y10, x20, y20, inverseArea, originX, originY);
+    }
+
+    return true;
+}
+
+// Per draw call state. Everything but the cull mode selects a raster
+// kernel, see GetRasterKernel.
+struct RasterState
+{
+    bool            depthTest;      // Less-than test and depth write
+    BlendMode       blendMode;
+    const Texture*  texture;        // Modulates the vertex color, varyings 4 and 5 are UV
+    TextureFilter   filter;
+    CullMode        cullMode;
+
+    RasterState()
+        : depthTest(true), blendMode(BlendMode::Opaque), texture(nullptr), filter(TextureFilter::Trilinear),
+          cullMode(CullMode::Back)
+    {}
+};
+
+// 4 float colors in [0, 1] to 4 ARGB8888 pixels
+inline __m128i PackArgb8888(const __m128 r, const __m128 g, const __m128 b, const __m128 a)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 scale = _mm_set1_ps(255.0f);
+    const __m128i ri = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(r, zero), _mm_set1_ps(1.0f)), scale));
+    const __m128i gi = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(g, zero), _mm_set1_ps(1.0f)), scale));
+    const __m128i bi = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(b, zero), _mm_set1_ps(1.0f)), scale));
+    const __m128i ai = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(a, zero), _mm_set1_ps(1.0f)), scale));
+    return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(ai, 24), _mm_slli_epi32(ri, 16)),
+                        _mm_or_si128(_mm_slli_epi32(gi, 8), bi));
+}
+
+// Loads and stores 4 pixels of a row in a pixel format, as ARGB8888.
+// count < 4 only touches the first count pixels, so the last block of a
+// row never reads or writes past the end of the buffer.
+template<PixelFormat Format>
+struct PixelBlock;
+
+template<>
+struct PixelBlock<PixelFormat::Argb8888>
+{
+    static inline __m128i Load(const unsigned char* row, const int x, const int count)
+    {
+        const unsigned int* pixels = (const unsigned int*) row + x;
+        if (count == 4)
+            return _mm_loadu_si128((const __m128i*) pixels);
+
+        unsigned int partial[4] = { 0, 0, 0, 0 };
+        for (int k = 0; k < count; ++k)
+            partial[k] = pixels[k];
+        return _mm_loadu_si128((const __m128i*) partial);
+    }
+
+    static inline void Store(unsigned char* row, const int x, const int count, const int mask, const __m128i argb)
+    {
+        unsigned int* pixels = (unsigned int*) row + x;
+        if (mask == 0xF)
+        {
+            _mm_storeu_si128((__m128i*) pixels, argb);
+            return;
+        }
+
+        unsigned int values[4];
+        _mm_storeu_si128((__m128i*) values, argb);
+        for (int k = 0; k < count; ++k)
+        {
+            if (mask & (1 << k))
+                pixels[k] = values[k];
+        }
+    }
+};
+
+template<>
+struct PixelBlock<PixelFormat::Rgb565>
+{
+    static inline __m128i Load(const unsigned char* row, const int x, const int count)
+    {
+        const unsigned short* pixels = (const unsigned short*) row + x;
+        __m128i packed;
+        if (count == 4)
+        {
+            packed = _mm_loadl_epi64((const __m128i*) pixels);
+        }
+        else
+        {
+            unsigned short partial[4] = { 0, 0, 0, 0 };
+            for (int k = 0; k < count; ++k)
+                partial[k] = pixels[k];
+            packed = _mm_loadl_epi64((const __m128i*) partial);
+        }
+
+        // Widen to 8 bits per channel by replicating the high bits
+        const __m128i p = _mm_unpacklo_epi16(packed, _mm_setzero_si128());
+        __m128i r = _mm_and_si128(_mm_srli_epi32(p, 11), _mm_set1_epi32(0x1F));
+        __m128i g = _mm_and_si128(_mm_srli_epi32(p, 5), _mm_set1_epi32(0x3F));
+        __m128i b = _mm_and_si128(p, _mm_set1_epi32(0x1F));
+        r = _mm_or_si128(_mm_slli_epi32(r, 3), _mm_srli_epi32(r, 2));
+        g = _mm_or_si128(_mm_slli_epi32(g, 2), _mm_srli_epi32(g, 4));
+        b = _mm_or_si128(_mm_slli_epi32(b, 3), _mm_srli_epi32(b, 2));
+        return _mm_or_si128(_mm_or_si128(_mm_set1_epi32(0xFF000000), _mm_slli_epi32(r, 16)),
+                            _mm_or_si128(_mm_slli_epi32(g, 8), b));
+    }
+
+    static inline void Store(unsigned char* row, const int x, const int count, const int mask, const __m128i argb)
+    {
+        const __m128i r = _mm_and_si128(_mm_srli_epi32(argb, 8), _mm_set1_epi32(0xF800));
+        const __m128i g = _mm_and_si128(_mm_srli_epi32(argb, 5), _mm_set1_epi32(0x07E0));
+        const __m128i b = _mm_and_si128(_mm_srli_epi32(argb, 3), _mm_set1_epi32(0x001F));
+        __m128i p = _mm_or_si128(_mm_or_si128(r, g), b);
+
+        // Sign extend the low halves so the signed saturating pack is exact
+        p = _mm_srai_epi32(_mm_slli_epi32(p, 16), 16);
+        p = _mm_packs_epi32(p, p);
+
+        unsigned short* pixels = (unsigned short*) row + x;
+        if (mask == 0xF)
+        {
+            _mm_storel_epi64((__m128i*) pixels, p);
+            return;
+        }
+
+        unsigned short values[8];
+        _mm_storeu_si128((__m128i*) values, p);
+        for (int k = 0; k < count; ++k)
+        {
+            if (mask & (1 << k))
+                pixels[k] = values[k];
+        }
+    }
+};
+
+// Mip level of detail of a 4 pixel block: log2 of the texels per pixel
+// step in the worst direction and lane. With u = U * w, U the plane of
+// u / w, du/dx = w * (dU/dx - u * d(1/w)/dx), likewise for y and v.
+inline float TextureLod(const TriangleSetup& setup, const __m128 u, const __m128 v, const __m128 w,
+                        const Texture* texture)
+{
+    // Missing UVs are stepped as 1 / w (see RasterizeTriangle), which gives
+    // them no slope
+    const Interpolant& pu = setup.varyingCount > 4 ? setup.varyings[4] : setup.inverseW;
+    const Interpolant& pv = setup.varyingCount > 5 ? setup.varyings[5] : setup.inverseW;
+    const Interpolant& pw = setup.inverseW;
+    const __m128 width = _mm_set1_ps((float) texture->GetWidth());
+    const __m128 height = _mm_set1_ps((float) texture->GetHeight());
+
+    const __m128 dudx = _mm_mul_ps(_mm_mul_ps(w, _mm_sub_ps(_mm_set1_ps(pu.dx), _mm_mul_ps(u, _mm_set1_ps(pw.dx)))), width);
+    const __m128 dvdx = _mm_mul_ps(_mm_mul_ps(w, _mm_sub_ps(_mm_set1_ps(pv.dx), _mm_mul_ps(v, _mm_set1_ps(pw.dx)))), height);
+    const __m128 dudy = _mm_mul_ps(_mm_mul_ps(w, _mm_sub_ps(_mm_set1_ps(pu.dy), _mm_mul_ps(u, _mm_set1_ps(pw.dy)))), width);
+    const __m128 dvdy = _mm_mul_ps(_mm_mul_ps(w, _mm_sub_ps(_mm_set1_ps(pv.dy), _mm_mul_ps(v, _mm_set1_ps(pw.dy)))), height);
+    __m128 rho = _mm_max_ps(_mm_add_ps(_mm_mul_ps(dudx, dudx), _mm_mul_ps(dvdx, dvdx)),
+                            _mm_add_ps(_mm_mul_ps(dudy, dudy), _mm_mul_ps(dvdy, dvdy)));
+    rho = _mm_max_ps(rho, _mm_shuffle_ps(rho, rho, _MM_SHUFFLE(1, 0, 3, 2)));
+    rho = _mm_max_ps(rho, _mm_shuffle_ps(rho, rho, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    // Squared, so half the log
+    return 0.5f * log2f(std::max(_mm_cvtss_f32(rho), 1e-12f));
+}
+
+// Draws a set up triangle in blocks of 4 pixels. Varyings 0..3 are the
+// straight alpha RGBA color (Gouraud shading), 4 and 5 the texture coordinates when
+// textured. All interpolants step incrementally; per pixel there is one
+// reciprocal to get w back from 1 / w. The state is all template
+// arguments, so the inner loop has no branches on it.
+template<bool DepthTest, BlendMode Blend, TextureFilter Filter, PixelFormat Format>
+void RasterizeTriangle(const TriangleSetup& setup, const RenderTarget& target, const Texture* texture)
+{
+    const __m128 lanes = _mm_setr_ps(0, 1, 2, 3);
+    const __m128 four = _mm_set1_ps(4.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const int varyingCount = setup.varyingCount;
+    const bool isTextured = Filter != TextureFilter::None;
+    const int steppedCount = std::max(varyingCount, isTextured ? 6 : 4);
+
+    __m128i edgeLanes[3], edgeBlockStep[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        const int s = setup.edgeStepX[i];
+        edgeLanes[i] = _mm_setr_epi32(0, s, s * 2, s * 3);
+        edgeBlockStep[i] = _mm_set1_epi32(s * 4);
+    }
+
+    for (int y = setup.minY; y <= setup.maxY; ++y)
+    {
+        const int row = y - setup.minY;
+        const float rowF = (float) row;
+
+        __m128i e0 = _mm_add_epi32(_mm_set1_epi32(setup.edges[0] + row * setup.edgeStepY[0]), edgeLanes[0]);
+        __m128i e1 = _mm_add_epi32(_mm_set1_epi32(setup.edges[1] + row * setup.edgeStepY[1]), edgeLanes[1]);
+        __m128i e2 = _mm_add_epi32(_mm_set1_epi32(setup.edges[2] + row * setup.edgeStepY[2]), edgeLanes[2]);
+
+        __m128 z = _mm_add_ps(_mm_set1_ps(setup.depth.origin + setup.depth.dy * rowF),
+                              _mm_mul_ps(_mm_set1_ps(setup.depth.dx), lanes));
+        const __m128 zStep = _mm_mul_ps(_mm_set1_ps(setup.depth.dx), four);
+        __m128 inverseW = _mm_add_ps(_mm_set1_ps(setup.inverseW.origin + setup.inverseW.dy * rowF),
+                                     _mm_mul_ps(_mm_set1_ps(setup.inverseW.dx), lanes));
+        const __m128 inverseWStep = _mm_mul_ps(_mm_set1_ps(setup.inverseW.dx), four);
+
+        __m128 varyings[RasterVertex::MaxVaryings];
+        __m128 varyingSteps[RasterVertex::MaxVaryings];
+        for (int k = 0; k < varyingCount; ++k)
+        {
+            const Interpolant& v = setup.varyings[k];
+            varyings[k] = _mm_add_ps(_mm_set1_ps(v.origin + v.dy * rowF), _mm_mul_ps(_mm_set1_ps(v.dx), lanes));
+            varyingSteps[k] = _mm_mul_ps(_mm_set1_ps(v.dx), four);
+        }
+        for (int k = varyingCount; k < steppedCount; ++k)
+        {
+            // Missing color channels and UVs are 1
+            varyings[k] = inverseW;
+            varyingSteps[k] = inverseWStep;
+        }
+
+        unsigned char* pixels = target.pixels + y * target.pitch;
+        float* depths = DepthTest ? target.depth + y * target.width : nullptr;
+
+        for (int x = setup.minX; x <= setup.maxX; x += 4)
+        {
+            const __m128i inside = _mm_cmpgt_epi32(_mm_or_si128(_mm_or_si128(e0, e1), e2), _mm_set1_epi32(-1));
+            int mask = _mm_movemask_ps(_mm_castsi128_ps(inside));
+            const int count = std::min(4, setup.maxX + 1 - x);
+            if (count < 4)
+                mask &= (1 << count) - 1;
+
+            if (DepthTest && mask)
+            {
+                // The last block of a row may hang over the end of the buffer
+                __m128 stored;
+                if (count == 4)
+                {
+                    stored = _mm_loadu_ps(depths + x);
+                }
+                else
+                {
+                    float partial[4] = { 0, 0, 0, 0 };
+                    for (int k = 0; k < count; ++k)
+                        partial[k] = depths[x + k];
+                    stored = _mm_loadu_ps(partial);
+                }
+                mask &= _mm_movemask_ps(_mm_cmplt_ps(z, stored));
+            }
+
+            if (mask)
+            {
+                // w = 1 / (1 / w), reciprocal estimate and a Newton step
+                __m128 w = _mm_rcp_ps(inverseW);
+                w = _mm_mul_ps(w, _mm_sub_ps(two, _mm_mul_ps(inverseW, w)));
+
+                // Vertex colors are straight alpha, premultiply them
+                __m128 a = _mm_mul_ps(varyings[3], w);
+                __m128 r = _mm_mul_ps(_mm_mul_ps(varyings[0], w), a);
+                __m128 g = _mm_mul_ps(_mm_mul_ps(varyings[1], w), a);
+                __m128 b = _mm_mul_ps(_mm_mul_ps(varyings[2], w), a);
+                if (isTextured)
+                {
+                    const __m128 u = _mm_mul_ps(varyings[4], w);
+                    const __m128 v = _mm_mul_ps(varyings[5], w);
+                    float lod = 0;
+                    if (Filter != TextureFilter::Nearest || texture->GetLevelCount() > 1)
+                        lod = TextureLod(setup, u, v, w, texture);
+
+                    __m128 tr, tg, tb, ta;
+                    texture->Sample4<Filter>(u, v, lod, &tr, &tg, &tb, &ta);
+                    r = _mm_mul_ps(r, tr);
+                    g = _mm_mul_ps(g, tg);
+                    b = _mm_mul_ps(b, tb);
+                    a = _mm_mul_ps(a, ta);
+                }
+
+                __m128i color = PackArgb8888(r, g, b, a);
+                if (Blend != BlendMode::Opaque)
+                    color = BlendPixels4<Blend>(color, PixelBlock<Format>::Load(pixels, x, count));
+                PixelBlock<Format>::Store(pixels, x, count, mask, color);
+
+                if (DepthTest)
+                {
+                    if (mask == 0xF)
+                    {
+                        _mm_storeu_ps(depths + x, z);
+                    }
+                    else
+                    {
+                        float zs[4];
+                        _mm_storeu_ps(zs, z);
+                        for (int k = 0; k < count; ++k)
+                        {
+                            if (mask & (1 << k))
+                                depths[x + k] = zs[k];
+                        }
+                    }
+                }
+            }
+
+            e0 = _mm_add_epi32(e0, edgeBlockStep[0]);
+            e1 = _mm_add_epi32(e1, edgeBlockStep[1]);
+            e2 = _mm_add_epi32(e2, edgeBlockStep[2]);
+            z = _mm_add_ps(z, zStep);
+            inverseW = _mm_add_ps(inverseW, inverseWStep);
+            for (int k = 0; k < steppedCount; ++k)
+                varyings[k] = _mm_add_ps(varyings[k], varyingSteps[k]);
+        }
+    }
+}
+
+typedef void (*RasterKernel)(const TriangleSetup& setup, const RenderTarget& target, const Texture* texture);
+
+// Every combination of states, instantiated at compile time. The index
+// is depth test, blend mode, texture filter, pixel format from most to
+// least significant.
+static const int RasterKernelCount = 2 * (int) BlendMode::Count * (int) TextureFilter::Count * (int) PixelFormat::Count;
+
+template<int Index, bool IsDone = (Index < 0)>
+struct RasterKernelTable
+{
+    static void Fill(RasterKernel* kernels)
+    {
+        const int blendModes = (int) BlendMode::Count;
+        const int filters = (int) TextureFilter::Count;
+        const int formats = (int) PixelFormat::Count;
+        const bool depthTest = Index / (blendModes * filters * formats) != 0;
+        const BlendMode blend = (BlendMode) (Index / (filters * formats) % blendModes);
+        const TextureFilter filter = (TextureFilter) (Index / formats % filters);
+        const PixelFormat format = (PixelFormat) (Index % formats);
+        kernels[Index] = &RasterizeTriangle<depthTest, blend, filter, format>;
+        RasterKernelTable<Index - 1>::Fill(kernels);
+    }
+};
+
+template<int Index>
+struct RasterKernelTable<Index, true>
+{
+    static void Fill(RasterKernel*)
+    {
+    }
+};
+
+// Picks the kernel for a draw call, once, instead of branching per pixel
+inline RasterKernel GetRasterKernel(const RasterState& state, const PixelFormat format)
+{
+    struct Table
+    {
+        RasterKernel kernels[RasterKernelCount];
+
+        Table()
+        {
+            RasterKernelTable<RasterKernelCount - 1>::Fill(this->kernels);
+        }
+    };
+    static const Table table;
+
+    const TextureFilter filter = state.texture ? state.filter : TextureFilter::None;
+    const int index = (((state.depthTest ? 1 : 0) * (int) BlendMode::Count + (int) state.blendMode)
+                      * (int) TextureFilter::Count + (int) filter) * (int) PixelFormat::Count + (int) format;
+    return table.kernels[index];
+}
\ No newline at end of file
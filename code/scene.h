@@ -0,0 +1,182 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include "math/mat4x4.h"
+
+// Flat transform hierarchy. Nodes live in contiguous arrays sorted breadth
+// first (by depth), so a parent is always updated before its children and
+// all nodes of one level can be updated in parallel. World matrices are
+// only recomputed for nodes whose local matrix changed and their subtrees.
+//
+// Nodes are referred to by handles, which stay valid when the arrays get
+// reordered after new nodes were added.
+class SceneGraph
+{
+private:
+    // Per slot, in breadth first order
+    std::vector<int>            parents;        // Slot of the parent, -1 for roots
+    std::vector<int>            depths;
+    std::vector<Mat4x4<float> > locals;
+    std::vector<Mat4x4<float> > worlds;
+    std::vector<unsigned char>  dirty;          // Local matrix changed
+    std::vector<unsigned int>   updated;        // Frame the world matrix was last recomputed
+    std::vector<int>            slotToHandle;
+
+    std::vector<int>            handleToSlot;
+    std::vector<int>            levelStarts;    // First slot of each depth, plus the end
+    unsigned int                frame;
+    bool                        isOrderDirty;
+
+    // Stable counting sort by depth. Parents have a smaller depth than their
+    // children, so they keep ending up in front of them.
+    void Reorder()
+    {
+        const int count = (int) this->parents.size();
+        int maxDepth = 0;
+        for (int i = 0; i < count; ++i)
+            maxDepth = std::max(maxDepth, this->depths[i]);
+
+        this->levelStarts.assign(maxDepth + 2, 0);
+        for (int i = 0; i < count; ++i)
+            this->levelStarts[this->depths[i] + 1]++;
+        for (int d = 1; d <= maxDepth + 1; ++d)
+            this->levelStarts[d] += this->levelStarts[d - 1];
+
+        std::vector<int> newSlots(count);
+        std::vector<int> next(this->levelStarts.begin(), this->levelStarts.end() - 1);
+        for (int i = 0; i < count; ++i)
+            newSlots[i] = next[this->depths[i]]++;
+
+        std::vector<int> parents(count), depths(count), slotToHandle(count);
+        std::vector<Mat4x4<float> > locals(count), worlds(count);
+        std::vector<unsigned char> dirty(count);
+        std::vector<unsigned int> updated(count);
+        for (int i = 0; i < count; ++i)
+        {
+            const int slot = newSlots[i];
+            const int parent = this->parents[i];
+            parents[slot] = parent >= 0 ? newSlots[parent] : -1;
+            depths[slot] = this->depths[i];
+            locals[slot] = this->locals[i];
+            worlds[slot] = this->worlds[i];
+            dirty[slot] = this->dirty[i];
+            updated[slot] = this->updated[i];
+            slotToHandle[slot] = this->slotToHandle[i];
+            this->handleToSlot[this->slotToHandle[i]] = slot;
+        }
+
+        this->parents.swap(parents);
+        this->depths.swap(depths);
+        this->locals.swap(locals);
+        this->worlds.swap(worlds);
+        this->dirty.swap(dirty);
+        this->updated.swap(updated);
+        this->slotToHandle.swap(slotToHandle);
+        this->isOrderDirty = false;
+    }
+
+public:
+    SceneGraph()
+        : frame(1), isOrderDirty(false)
+    {
+    }
+
+    void Reserve(int count)
+    {
+        this->parents.reserve(count);
+        this->depths.reserve(count);
+        this->locals.reserve(count);
+        this->worlds.reserve(count);
+        this->dirty.reserve(count);
+        this->updated.reserve(count);
+        this->slotToHandle.reserve(count);
+        this->handleToSlot.reserve(count);
+    }
+
+    // Returns the handle of the new node, parent -1 adds a root
+    int AddNode(int parent = -1, const Mat4x4<float>& local = Mat4x4<float>())
+    {
+        const int handle = (int) this->handleToSlot.size();
+        const int slot = (int) this->parents.size();
+        const int parentSlot = parent >= 0 ? this->handleToSlot[parent] : -1;
+
+        this->parents.push_back(parentSlot);
+        this->depths.push_back(parentSlot >= 0 ? this->depths[parentSlot] + 1 : 0);
+        this->locals.push_back(local);
+        this->worlds.push_back(local);
+        this->dirty.push_back(1);
+        this->updated.push_back(0);
+        this->slotToHandle.push_back(handle);
+        this->handleToSlot.push_back(slot);
+        this->isOrderDirty = true;
+
+        return handle;
+    }
+
+    inline int GetNodeCount() const { return (int) this->parents.size(); }
+
+    int GetParent(int node) const
+    {
+        const int parentSlot = this->parents[this->handleToSlot[node]];
+        return parentSlot >= 0 ? this->slotToHandle[parentSlot] : -1;
+    }
+
+    void SetLocal(int node, const Mat4x4<float>& local)
+    {
+        const int slot = this->handleToSlot[node];
+        this->locals[slot] = local;
+        this->dirty[slot] = 1;
+    }
+
+    inline const Mat4x4<float>& GetLocal(int node) const
+    {
+        return this->locals[this->handleToSlot[node]];
+    }
+
+    // Valid after Update()
+    inline const Mat4x4<float>& GetWorld(int node) const
+    {
+        return this->worlds[this->handleToSlot[node]];
+    }
+
+    // True if the world matrix of the node changed in the last Update()
+    inline bool WasUpdated(int node) const
+    {
+        return this->updated[this->handleToSlot[node]] == this->frame - 1;
+    }
+
+    // Recomputes the world matrices of all dirty subtrees
+    void Update()
+    {
+        if (this->isOrderDirty)
+            this->Reorder();
+
+        const unsigned int frame = this->frame;
+        const int levelCount = (int) this->levelStarts.size() - 1;
+        for (int level = 0; level < levelCount; ++level)
+        {
+            const int begin = this->levelStarts[level];
+            const int end = this->levelStarts[level + 1];
+
+            // Small levels are not worth waking up the thread pool for
+            #pragma omp parallel for if(end - begin > 1024)
+            for (int slot = begin; slot < end; ++slot)
+            {
+                const int parent = this->parents[slot];
+                const bool isParentUpdated = parent >= 0 && this->updated[parent] == frame;
+                if (!this->dirty[slot] && !isParentUpdated)
+                    continue;
+
+                if (parent >= 0)
+                    this->worlds[slot] = this->worlds[parent] * this->locals[slot];
+                else
+                    this->worlds[slot] = this->locals[slot];
+
+                this->dirty[slot] = 0;
+                this->updated[slot] = frame;
+            }
+        }
+
+        this->frame++;
+    }
+};
\ No newline at end of file
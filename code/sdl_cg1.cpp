@@ -2,11 +2,35 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <iostream>
+#include <algorithm>
 
 #include <GL/glew.h> // Later for OpenGL
 #include <SDL.h>
 
 #include "math/line.h"
+#include "math/triangle.h"
+#include "math/mat4x4.h"
+#include "math/quat.h"
+#include "math/vec2.h"
+
+#include "camera.h"
+#include "scene.h"
+#include "culling.h"
+#include "bvh.h"
+#include "mesh.h"
+#include "triangle_setup.h"
+#include "texture.h"
+#include "raster.h"
+#include "kernels.h"
+#include "clip.h"
+#include "circle.h"
+#include "ellipse.h"
+#include "lines.h"
+#include "bezier.h"
+#include "path.h"
+#include "stroke.h"
+#include "floodfill.h"
+#include "sprite.h"
 
 class SDLClock
 {
@@ -72,6 +96,19 @@ struct Color
     unsigned char a;
 };
 
+// Format: BGRA, which is one ARGB8888 value per pixel
+inline unsigned int ToArgb8888(const Color& color)
+{
+    return (color.a << 24) | (color.r << 16) | (color.g << 8) | color.b;
+}
+
+// Colors are straight alpha, blending works on premultiplied ARGB8888
+inline unsigned int Premultiply(const Color& color)
+{
+    return (color.a << 24) | (Div255(color.r * color.a) << 16) 
+         | (Div255(color.g * color.a) << 8) | Div255(color.b * color.a);
+}
+
 struct SDLWindowDimension
 {
     int width;
@@ -164,6 +201,8 @@ public:
       
     inline int GetWidth() const { return this->width; }
     inline int GetHeight() const { return this->height; }
+    inline int GetPitch() const { return this->pitch; }
+    inline unsigned char* GetMemory() const { return this->memory; }
     
     inline void SetPixel(const int x, const int y, const Color& color)
     {
@@ -176,21 +215,14 @@ public:
     
     void Clear(const Color& color)
     {
-        const int columns = this->width * this->bytesPerPixel;
+        const unsigned int value = ToArgb8888(color);
         const int rows = this->height;
+        const Kernels& kernels = GetKernels();
         
 		#pragma omp parallel for
         for (int i = 0; i < rows; ++i)
         {
-            for (int j = 0; j < columns; j += this->bytesPerPixel)
-            {
-                // Format: BGRA
-                const int index = i*columns + j;
-                this->memory[index] = color.b;
-                this->memory[index + 1] = color.g;
-                this->memory[index + 2] = color.r;
-                this->memory[index + 3] = color.a;  
-            }
+            kernels.fillSpan((unsigned int*) (this->memory + i * this->pitch), this->width, value);
         }
     }
     
@@ -214,8 +246,36 @@ private:
     SDL_Renderer*   renderer;
     SDLBackBuffer*  backbuffer;
 	int*			scanbuffer;
+    float*          depthbuffer;
+    ClipRect        clipRect;       // Top of the scissor stack
     // TODO: scanbuffer? edgetable? ...
     
+    // Scratch for DrawTriangles, kept to avoid allocations per draw
+    std::vector<Vec4<float> >   screenCorners;
+    std::vector<int>            visibleTriangles;
+    std::vector<unsigned int>   spanBuffer;
+    std::vector<RasterVertex>   clippedVertices;
+    
+    std::vector<ClipRect>       scissors;
+    
+    CircleCache                 circles;
+    
+    // Scratch for the ellipses
+    std::vector<int>            ellipseXs;
+    std::vector<int>            ellipseYs;
+    std::vector<int>            ellipseSpans;
+    std::vector<int>            spanLefts;
+    std::vector<int>            spanRights;
+    
+    CurveCache                  curves;
+    CoverageBuffer              coverage;
+    
+    // Scratch for the thick lines
+    std::vector<Vec2<float> >   strokePoints;
+    StrokeMask                  strokeMask;
+    
+    FloodFiller                 floodFiller;
+    
 public:
     SDLRenderer(SDLWindow* window)
         : window(window)
@@ -228,6 +288,14 @@ public:
         const SDLWindowDimension dimension = this->window->GetWindowDimension();
         this->backbuffer = new SDLBackBuffer(this->renderer, dimension.width, dimension.height);
         this->scanbuffer = new int[dimension.height * 2];
+        this->depthbuffer = new float[dimension.width * dimension.height];
+        this->ClearDepth();
+        
+        this->clipRect.minX = 0;
+        this->clipRect.minY = 0;
+        this->clipRect.maxX = dimension.width - 1;
+        this->clipRect.maxY = dimension.height - 1;
+        this->scissors.assign(1, this->clipRect);
 		
 		return (this->renderer != nullptr);
     }
@@ -235,25 +303,94 @@ public:
     void Shutdown() const
     {
 		delete this->scanbuffer;
+        delete[] this->depthbuffer;
         delete this->backbuffer;
         SDL_DestroyRenderer(this->renderer);
     }
     
+    // Everything drawn is clipped to the scissor rectangle, which is the
+    // intersection of the pushed ones. (x, y) is its bottom left pixel, like
+    // FillRect. The whole buffer is always at the bottom of the stack.
+    void PushScissor(const int x, const int y, const int width, const int height)
+    {
+        const int halfWidth = this->backbuffer->GetWidth() / 2;
+        const int halfHeight = this->backbuffer->GetHeight() / 2;
+        const ClipRect& top = this->scissors.back();
+        ClipRect scissor;
+        scissor.minX = std::max(x + halfWidth, top.minX);
+        scissor.minY = std::max(halfHeight - (y + height - 1), top.minY);
+        scissor.maxX = std::min(x + width - 1 + halfWidth, top.maxX);
+        scissor.maxY = std::min(halfHeight - y, top.maxY);
+        this->scissors.push_back(scissor);
+        this->clipRect = scissor;
+    }
+    
+    void PopScissor()
+    {
+        if (this->scissors.size() > 1)
+            this->scissors.pop_back();
+        this->clipRect = this->scissors.back();
+    }
+    
+    // In backbuffer coordinates, empty if nothing can be drawn
+    inline const ClipRect& GetScissor() const
+    {
+        return this->clipRect;
+    }
+    
     inline void SetPixel(const int x, const int y, const Color& color) const
     {
-        const int width = this->backbuffer->GetWidth();
-        const int height = this->backbuffer->GetHeight();
+        const int xPos = x + (this->backbuffer->GetWidth() / 2);
+        const int yPos = (this->backbuffer->GetHeight() / 2) - y;
         
-        const int xPos = x + (width / 2);
-        const int yPos = (height / 2) - y;
-        
-		// TODO remove if clipping for lines and polygons works
-        if (xPos > 0 && yPos > 0 && xPos < width && yPos < height)
+        if (this->clipRect.Contains(xPos, yPos, xPos, yPos))
         {
             this->backbuffer->SetPixel(xPos, yPos, color);
         }
     }
 	
+    inline void BlendPixel(const int x, const int y, const Color& color, const BlendMode mode = BlendMode::SrcOver)
+    {
+        const int xPos = x + (this->backbuffer->GetWidth() / 2);
+        const int yPos = (this->backbuffer->GetHeight() / 2) - y;
+        
+        if (this->clipRect.Contains(xPos, yPos, xPos, yPos))
+        {
+            unsigned int* pixel = (unsigned int*) (this->backbuffer->GetMemory() + yPos * this->backbuffer->GetPitch()) + xPos;
+            const unsigned int source = Premultiply(color);
+            GetKernels().blendSpan[(int) mode](pixel, &source, 1);
+        }
+    }
+    
+    // Blends a solid rectangle, (x, y) is its bottom left pixel. Whole rows
+    // go through the SIMD span kernels.
+    void FillRect(const int x, const int y, const int width, const int height, const Color& color,
+                  const BlendMode mode = BlendMode::SrcOver)
+    {
+        const int halfWidth = this->backbuffer->GetWidth() / 2;
+        const int halfHeight = this->backbuffer->GetHeight() / 2;
+        const ClipRect& clip = this->clipRect;
+        const int xBegin = std::max(x + halfWidth, clip.minX);
+        const int xEnd = std::min(x + width + halfWidth, clip.maxX + 1);
+        const int yBegin = std::max(halfHeight - (y + height - 1), clip.minY);
+        const int yEnd = std::min(halfHeight - y + 1, clip.maxY + 1);
+        if (xBegin >= xEnd || yBegin >= yEnd)
+            return;
+        
+        this->spanBuffer.assign(xEnd - xBegin, Premultiply(color));
+        const unsigned int* source = this->spanBuffer.data();
+        unsigned char* memory = this->backbuffer->GetMemory();
+        const int pitch = this->backbuffer->GetPitch();
+        const int count = xEnd - xBegin;
+        void (*blendSpan)(unsigned int*, const unsigned int*, int) = GetKernels().blendSpan[(int) mode];
+        
+        #pragma omp parallel for if ((yEnd - yBegin) * count > 65536)
+        for (int row = yBegin; row < yEnd; ++row)
+        {
+            blendSpan((unsigned int*) (memory + row * pitch) + xBegin, source, count);
+        }
+    }
+    
 	inline void SetScanBuffer(const int y, const int xMin, const int xMax)
 	{
 		this->scanbuffer[y * 2] = xMin;
@@ -262,16 +399,26 @@ public:
 	
 	void FillShape(const int yMin, const int yMax)
 	{
+        const int width = this->backbuffer->GetWidth();
+        const int height = this->backbuffer->GetHeight();
+        unsigned char* memory = this->backbuffer->GetMemory();
+        const int pitch = this->backbuffer->GetPitch();
+        const Kernels& kernels = GetKernels();
+        
 		int xMin, xMax;
 		for (int y = yMax; y >= yMin; y--)
 		{
 			xMin = scanbuffer[y * 2];
 			xMax = scanbuffer[(y * 2) + 1];
 			
-			for(int x = xMin; x < xMax; x++)
-			{
-				this->SetPixel(x, y, Color{ 255, 255, 255, 255 });
-			}		
+            // Whole span at once, clipped like SetPixel
+            const int yPos = (height / 2) - y;
+            const int xBegin = std::max(xMin + (width / 2), this->clipRect.minX);
+            const int xEnd = std::min(xMax + (width / 2), this->clipRect.maxX + 1);
+            if (yPos >= this->clipRect.minY && yPos <= this->clipRect.maxY && xBegin < xEnd)
+            {
+                kernels.fillSpan((unsigned int*) (memory + yPos * pitch) + xBegin, xEnd - xBegin, 0xFFFFFFFF);
+            }
 		}
 	}
 
@@ -280,81 +427,295 @@ public:
         this->backbuffer->Clear(color);
     }
     
+    // NDC depth, 1 is the far plane
+    void ClearDepth(const float depth = 1.0f)
+    {
+        GetKernels().fillDepth(this->depthbuffer,
+                               this->backbuffer->GetWidth() * this->backbuffer->GetHeight(), depth);
+    }
+    
+    inline RenderTarget GetRenderTarget() const
+    {
+        RenderTarget target;
+        target.pixels = this->backbuffer->GetMemory();
+        target.depth = this->depthbuffer;
+        target.format = PixelFormat::Argb8888;
+        target.width = this->backbuffer->GetWidth();
+        target.height = this->backbuffer->GetHeight();
+        target.pitch = this->backbuffer->GetPitch();
+        return target;
+    }
+    
     inline void Resize()
     {
         
     }
     
-    inline void SwapBuffers() const
+    inline void SwapBuffers()
     {
         this->backbuffer->SwapBuffers(this->renderer);
+        
+        // Curves and circles not drawn this frame leave their caches
+        this->curves.Evict();
+        this->circles.Evict();
     }
     
-    void DrawLine(const Line& line, const Color& color)
+    // Anti-aliased lines blend color into the two pixels nearest to the
+    // line at every step, see DrawLineWu
+    void DrawLine(const Line& line, const Color& color, const bool antialiased = false)
     {
-        this->DrawDDALine(line, color);
+        if (antialiased)
+            this->DrawWuLine(line, color);
+        else
+            this->DrawDDALine(line, color);
+    }
+    
+    void DrawWuLine(const Line& line, const Color& color)
+    {
+        const int halfWidth = this->backbuffer->GetWidth() / 2;
+        const int halfHeight = this->backbuffer->GetHeight() / 2;
+        DrawLineWu(this->backbuffer->GetMemory(), this->backbuffer->GetPitch(), this->clipRect,
+                   line.x0 + halfWidth, halfHeight - line.y0, line.x1 + halfWidth, halfHeight - line.y1,
+                   Premultiply(color));
     }
     
     void DrawDDALine(const Line& line, const Color& color)
     {   
-        float m = ((float)(line.y1 - line.y0)) / (line.x1 - line.x0);
+        // Steps one pixel along the major axis and the minor axis in 16.16
+        // fixed point, so rounding is an add and a shift instead of floor().
+        // The line is clipped to the scissor once, see DrawLinePixels.
+        const int halfWidth = this->backbuffer->GetWidth() / 2;
+        const int halfHeight = this->backbuffer->GetHeight() / 2;
+        DrawLinePixels(this->backbuffer->GetMemory(), this->backbuffer->GetPitch(), this->clipRect,
+                       line.x0 + halfWidth, halfHeight - line.y0, line.x1 + halfWidth, halfHeight - line.y1,
+                       ToArgb8888(color));
+        
+        // From course:
+        // const float m = ((float)(line.y1 - line.y0)) / (line.x1 - line.x0);
+        // float y = line.y0;
+        // 
+        // for(int x = line.x0; x <= line.x1; ++x)
+        // {
+        //     this->SetPixel(x, (int) floor(y + 0.5), color);
+        //     y += m;
+        // }
+    }
+    
+    void DrawLine(const FixedLine& line, const Color& color)
+    {
+        // Bresenham with subpixel endpoints: every pixel center along the
+        // major axis between the endpoints is lit, the minor coordinate is
+        // the exact rounded intersection, kept as quotient and remainder.
+        const bool xMajor = abs(line.x1.raw - line.x0.raw) >= abs(line.y1.raw - line.y0.raw);
+        int a0 = xMajor ? line.x0.raw : line.y0.raw;
+        int a1 = xMajor ? line.x1.raw : line.y1.raw;
+        int b0 = xMajor ? line.y0.raw : line.x0.raw;
+        int b1 = xMajor ? line.y1.raw : line.x1.raw;
+        if (a0 > a1)
+        {
+            std::swap(a0, a1);
+            std::swap(b0, b1);
+        }
         
-        if (line.x0 <= line.x1)
+        const int first = Fixed28_4::FromRaw(a0).Ceil();
+        const int last = Fixed28_4::FromRaw(a1).Floor();
+        const long long da = a1 - a0;
+        const long long db = b1 - b0;
+        if (first > last)
+            return;
+        if (da == 0)
         {
-            if (m > 1)
-            {
-                m = 1.0f / m;
-                float x = line.x0;
-                for(int y = line.y0; y <= line.y1; ++y, x += m)
-                    this->SetPixel((int) floor(x + 0.5), y, color);
-            }
-            else if (m < -1)
-            {
-                m = 1.0f / m;
-                float x = line.x0;
-                for(int y = line.y0; y >= line.y1; --y, x -= m)
-                    this->SetPixel((int) floor(x - 0.5), y, color);
-            }
+            // Both endpoints on the same pixel center
+            const int b = Fixed28_4::FromRaw(b0).Round();
+            this->SetPixel(xMajor ? first : b, xMajor ? b : first, color);
+            return;
+        }
+        
+        // b(a) = b0 + (a - a0) * db / da, rounded: floor((n + da/2) / da)
+        // in raw units, n = b0 * da + (a - a0) * db
+        const long long denominator = da * Fixed28_4::One;
+        const long long n = (long long) b0 * da
+                          + ((long long) first * Fixed28_4::One - a0) * db
+                          + da * Fixed28_4::Half;
+        const long long step = db * Fixed28_4::One;
+        
+        int q = (int) FloorDiv(n, denominator);
+        int r = (int) (n - (long long) q * denominator);
+        const int stepQ = (int) FloorDiv(step, denominator);
+        const int stepR = (int) (step - (long long) stepQ * denominator);
+        const int d = (int) denominator;
+        
+        for (int a = first; a <= last; ++a)
+        {
+            if (xMajor)
+                this->SetPixel(a, q, color);
             else
+                this->SetPixel(q, a, color);
+            
+            q += stepQ;
+            r += stepR;
+            if (r >= d)
             {
-                float y = line.y0;
-                for(int x = line.x0; x <= line.x1; ++x, y += m)
-                    this->SetPixel(x, (int) floor(y + 0.5), color);
+                r -= d;
+                q++;
             }
         }
-        else
+    }
+    
+    // Vertices must lie within +-1024 pixels of the window center so the
+    // edge functions fit in 32 bits. Pixel centers are at integer
+    // coordinates; pixels on a shared edge are owned by exactly one
+    // triangle (top-left fill rule).
+    void FillTriangle(const Triangle& triangle, const Color& color)
+    {
+        const int width = this->backbuffer->GetWidth();
+        const int height = this->backbuffer->GetHeight();
+        
+        // To backbuffer space (y down), still 28.4
+        const int centerX = (width / 2) * Fixed28_4::One;
+        const int centerY = (height / 2) * Fixed28_4::One;
+        int x0 = centerX + triangle.x0.raw, y0 = centerY - triangle.y0.raw;
+        int x1 = centerX + triangle.x1.raw, y1 = centerY - triangle.y1.raw;
+        int x2 = centerX + triangle.x2.raw, y2 = centerY - triangle.y2.raw;
+        
+        // Make the winding clockwise on screen, so inside is positive
+        const long long area = (long long) (x1 - x0) * (y2 - y0) - (long long) (y1 - y0) * (x2 - x0);
+        if (area == 0)
+            return;
+        if (area < 0)
+        {
+            std::swap(x1, x2);
+            std::swap(y1, y2);
+        }
+        
+        int minX = Fixed28_4::FromRaw(std::min(x0, std::min(x1, x2))).Ceil();
+        int maxX = Fixed28_4::FromRaw(std::max(x0, std::max(x1, x2))).Floor();
+        int minY = Fixed28_4::FromRaw(std::min(y0, std::min(y1, y2))).Ceil();
+        int maxY = Fixed28_4::FromRaw(std::max(y0, std::max(y1, y2))).Floor();
+        minX = std::max(minX, this->clipRect.minX);
+        minY = std::max(minY, this->clipRect.minY);
+        maxX = std::min(maxX, this->clipRect.maxX);
+        maxY = std::min(maxY, this->clipRect.maxY);
+        if (minX > maxX || minY > maxY)
+            return;
+        
+        // Edge functions E(x, y) = dx * (y - yi) - dy * (x - xi), evaluated at
+        // the first pixel center. Top edges (horizontal, going right) and
+        // left edges (going up) keep E == 0, the others need E > 0, which
+        // is a bias of -1 on integers.
+        const int px = minX * Fixed28_4::One;
+        const int py = minY * Fixed28_4::One;
+        const int xs[3] = { x0, x1, x2 };
+        const int ys[3] = { y0, y1, y2 };
+        int row[3], stepX[3], stepY[3];
+        for (int i = 0; i < 3; ++i)
         {
-            if (m > 1)
+            const int j = (i + 1) % 3;
+            const int dx = xs[j] - xs[i];
+            const int dy = ys[j] - ys[i];
+            const bool isTopLeft = (dy == 0 && dx > 0) || dy < 0;
+            row[i] = (int) ((long long) dx * (py - ys[i]) - (long long) dy * (px - xs[i]))
+                   - (isTopLeft ? 0 : 1);
+            stepX[i] = -dy * Fixed28_4::One;
+            stepY[i] = dx * Fixed28_4::One;
+        }
+        
+        for (int y = minY; y <= maxY; ++y)
+        {
+            int e0 = row[0], e1 = row[1], e2 = row[2];
+            for (int x = minX; x <= maxX; ++x)
             {
-                m = 1.0f / m;
-                float x = line.x0;
-                for(int y = line.y0; y >= line.y1; --y, x -= m)
-                    this->SetPixel((int) floor(x - 0.5), y, color);
+                if ((e0 | e1 | e2) >= 0)
+                    this->backbuffer->SetPixel(x, y, color);
+                
+                e0 += stepX[0];
+                e1 += stepX[1];
+                e2 += stepX[2];
             }
-            else if (m < -1)
+            
+            row[0] += stepY[0];
+            row[1] += stepY[1];
+            row[2] += stepY[2];
+        }
+    }
+    
+    // Draws triangleCount triangles of 3 consecutive vertices with clip
+    // space positions. The first varyingCount varyings are interpolated
+    // perspective correct, 0..3 being the RGBA color in [0, 1] and 4..5
+    // the texture coordinates if the state has a texture.
+    void DrawTriangles(const RasterVertex* vertices, const int triangleCount, const int varyingCount,
+                       const RasterState& state = RasterState())
+    {
+        const int width = this->backbuffer->GetWidth();
+        const int height = this->backbuffer->GetHeight();
+        
+        // Triangles reaching behind the near plane or out of the guard band
+        // are collapsed, CullTriangles drops them for zero area. What is
+        // left of them after clipping is appended as extra triangles.
+        const float bandX = GuardBand / (width * 0.5f);
+        const float bandY = GuardBand / (height * 0.5f);
+        this->clippedVertices.clear();
+        this->screenCorners.resize(triangleCount * 3);
+        Vec4<float>* corners = this->screenCorners.data();
+        for (int t = 0; t < triangleCount; ++t)
+        {
+            const RasterVertex* triangle = vertices + t * 3;
+            const int code0 = ClipOutcode(triangle[0].position, bandX, bandY);
+            const int code1 = ClipOutcode(triangle[1].position, bandX, bandY);
+            const int code2 = ClipOutcode(triangle[2].position, bandX, bandY);
+            if ((code0 | code1 | code2) == 0)
             {
-                m = 1.0f / m;
-                float x = line.x0;
-                for(int y = line.y0; y <= line.y1; ++y, x += m)
-                    this->SetPixel((int) floor(x + 0.5), y, color);
+                for (int k = 0; k < 3; ++k)
+                    corners[t * 3 + k] = triangle[k].position;
+                continue;
             }
-            else
+            
+            for (int k = 0; k < 3; ++k)
+                corners[t * 3 + k] = Vec4<float>(0, 0, 0, 1);
+            if ((code0 & code1 & code2) != 0)
+                continue;
+            
+            RasterVertex polygon[MaxClippedVertices];
+            const int count = ClipTriangle(triangle[0], triangle[1], triangle[2], varyingCount,
+                                           code0 | code1 | code2, bandX, bandY, polygon);
+            for (int k = 2; k < count; ++k)
             {
-                float y = line.y1;
-                for(int x = line.x1; x <= line.x0; ++x, y += m)
-                    this->SetPixel(x, (int) floor(y + 0.5), color);    
+                this->clippedVertices.push_back(polygon[0]);
+                this->clippedVertices.push_back(polygon[k - 1]);
+                this->clippedVertices.push_back(polygon[k]);
             }
         }
         
-        // From course:
-        // const float m = ((float)(line.y1 - line.y0)) / (line.x1 - line.x0);
-        // float y = line.y0;
-        // 
-        // for(int x = line.x0; x <= line.x1; ++x)
-        // {
-        //     this->SetPixel(x, (int) floor(y + 0.5), color);
-        //     y += m;
-        // }
+        const int clippedCount = (int) this->clippedVertices.size() / 3;
+        const int totalCount = triangleCount + clippedCount;
+        this->screenCorners.resize(totalCount * 3);
+        this->visibleTriangles.resize(totalCount);
+        corners = this->screenCorners.data();
+        for (int i = 0; i < clippedCount * 3; ++i)
+            corners[triangleCount * 3 + i] = this->clippedVertices[i].position;
+        
+        ProjectToScreen(corners, corners, totalCount * 3, width, height);
+        const int visibleCount = CullTriangles(corners, totalCount, state.cullMode, this->visibleTriangles.data());
+        
+        const RenderTarget target = this->GetRenderTarget();
+        const RasterKernel kernel = GetRasterKernel(state, target.format);
+        for (int i = 0; i < visibleCount; ++i)
+        {
+            const int t = this->visibleTriangles[i];
+            const RasterVertex* triangle = t < triangleCount
+                                         ? vertices + t * 3
+                                         : this->clippedVertices.data() + (t - triangleCount) * 3;
+            RasterVertex screen[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                screen[k] = triangle[k];
+                screen[k].position = corners[t * 3 + k];
+            }
+            
+            TriangleSetup setup;
+            if (SetupTriangle(screen[0], screen[1], screen[2], varyingCount, this->clipRect, &setup))
+                kernel(setup, target, state.texture);
+        }
     }
     
     void DrawMidPointLine(const Line& line, const Color& color)
@@ -443,6 +804,425 @@ public:
             DrawAllCirclePoints(xMid, yMid, x, y, color); 
         }
     }
+    
+    // Midpoint circle outline without a bounds check per pixel: the octants
+    // are clipped against the clip rect once, then written unchecked
+    void DrawCircle(const int xMid, const int yMid, const int radius, const Color& color)
+    {
+        const int x = xMid + (this->backbuffer->GetWidth() / 2);
+        const int y = (this->backbuffer->GetHeight() / 2) - yMid;
+        if (radius < 0 || !CircleOutlineIntersects(this->clipRect, x, y, radius))
+            return;
+        
+        DrawCircleOctants(this->backbuffer->GetMemory(), this->backbuffer->GetPitch(), this->clipRect, x, y,
+                          this->circles.Get(radius).steps, ToArgb8888(color));
+    }
+    
+    // Filled circle covering exactly the DrawCircle outline, one clipped
+    // horizontal span per row through the SIMD span kernels
+    void FillCircle(const int xMid, const int yMid, const int radius, const Color& color,
+                    const BlendMode mode = BlendMode::SrcOver)
+    {
+        if (radius < 0)
+            return;
+        
+        const int x = xMid + (this->backbuffer->GetWidth() / 2);
+        const int y = (this->backbuffer->GetHeight() / 2) - yMid;
+        if (!this->clipRect.Intersects(x - radius, y - radius, x + radius, y + radius))
+            return;
+        
+        const unsigned int value = Premultiply(color);
+        if (mode != BlendMode::Opaque)
+            this->spanBuffer.assign(radius * 2 + 1, value);
+        
+        FillCircleRows(this->backbuffer->GetMemory(), this->backbuffer->GetPitch(), this->clipRect, x, y,
+                       this->circles.Get(radius).halfWidths, value, mode, this->spanBuffer.data());
+    }
+    
+    // Many circles of one color, outlined or filled, e.g. plot markers.
+    // Each radius is rasterized once into the circle cache, which keeps the
+    // radii drawn every frame, so a circle costs little more than its writes.
+    void DrawCircles(const Vec2<int>* centers, const int* radii, const int count, const Color& color,
+                     const bool filled = false, const BlendMode mode = BlendMode::SrcOver)
+    {
+        this->DrawCircleBatch(centers, radii, 1, count, color, filled, mode);
+    }
+    
+    // Same with one radius for all of them
+    void DrawCircles(const Vec2<int>* centers, const int count, const int radius, const Color& color,
+                     const bool filled = false, const BlendMode mode = BlendMode::SrcOver)
+    {
+        this->DrawCircleBatch(centers, &radius, 0, count, color, filled, mode);
+    }
+    
+    // Axis aligned midpoint ellipse outline, clipped per quadrant
+    void DrawEllipse(const int xMid, const int yMid, const int radiusX, const int radiusY, const Color& color)
+    {
+        if (radiusX < 0 || radiusY < 0)
+            return;
+        
+        EllipseQuadrant(radiusX, radiusY, &this->ellipseXs, &this->ellipseYs);
+        DrawEllipseQuadrants(this->backbuffer->GetMemory(), this->backbuffer->GetPitch(), this->clipRect,
+                             xMid + (this->backbuffer->GetWidth() / 2), (this->backbuffer->GetHeight() / 2) - yMid,
+                             this->ellipseXs, this->ellipseYs, ToArgb8888(color));
+    }
+    
+    // Filled axis aligned ellipse covering exactly the DrawEllipse outline
+    void FillEllipse(const int xMid, const int yMid, const int radiusX, const int radiusY, const Color& color,
+                     const BlendMode mode = BlendMode::SrcOver)
+    {
+        if (radiusX < 0 || radiusY < 0)
+            return;
+        
+        const int x = xMid + (this->backbuffer->GetWidth() / 2);
+        const int y = (this->backbuffer->GetHeight() / 2) - yMid;
+        if (!this->clipRect.Intersects(x - radiusX, y - radiusY, x + radiusX, y + radiusY))
+            return;
+        
+        const unsigned int value = Premultiply(color);
+        if (mode != BlendMode::Opaque)
+            this->spanBuffer.assign(radiusX * 2 + 1, value);
+        
+        EllipseQuadrant(radiusX, radiusY, &this->ellipseXs, &this->ellipseYs);
+        EllipseSpans(this->ellipseXs, this->ellipseYs, &this->ellipseSpans);
+        FillCircleRows(this->backbuffer->GetMemory(), this->backbuffer->GetPitch(), this->clipRect, x, y,
+                       this->ellipseSpans, value, mode, this->spanBuffer.data());
+    }
+    
+    // Elliptic (or with equal radii circular) arc from angle start to end,
+    // in radians counter-clockwise from the positive x axis
+    void DrawArc(const int xMid, const int yMid, const int radiusX, const int radiusY,
+                 const float start, const float end, const Color& color)
+    {
+        if (radiusX < 0 || radiusY < 0)
+            return;
+        
+        EllipseQuadrant(radiusX, radiusY, &this->ellipseXs, &this->ellipseYs);
+        DrawEllipseArc(this->backbuffer->GetMemory(), this->backbuffer->GetPitch(), this->clipRect,
+                       xMid + (this->backbuffer->GetWidth() / 2), (this->backbuffer->GetHeight() / 2) - yMid,
+                       this->ellipseXs, this->ellipseYs, start, end, ToArgb8888(color));
+    }
+    
+    // Ellipse rotated counter-clockwise by angle (radians) around its center
+    void DrawRotatedEllipse(const int xMid, const int yMid, const int radiusX, const int radiusY,
+                            const float angle, const Color& color)
+    {
+        if (radiusX < 0 || radiusY < 0)
+            return;
+        
+        const int extent = RotatedEllipseSpans(radiusX, radiusY, angle, &this->spanLefts, &this->spanRights);
+        DrawSpanRowsOutline(this->backbuffer->GetMemory(), this->backbuffer->GetPitch(), this->clipRect,
+                            xMid + (this->backbuffer->GetWidth() / 2), (this->backbuffer->GetHeight() / 2) - yMid,
+                            extent, this->spanLefts, this->spanRights, ToArgb8888(color));
+    }
+    
+    void FillRotatedEllipse(const int xMid, const int yMid, const int radiusX, const int radiusY,
+                            const float angle, const Color& color, const BlendMode mode = BlendMode::SrcOver)
+    {
+        if (radiusX < 0 || radiusY < 0)
+            return;
+        
+        const unsigned int value = Premultiply(color);
+        if (mode != BlendMode::Opaque)
+            this->spanBuffer.assign(std::max(radiusX, radiusY) * 2 + 1, value);
+        
+        const int extent = RotatedEllipseSpans(radiusX, radiusY, angle, &this->spanLefts, &this->spanRights);
+        FillSpanRows(this->backbuffer->GetMemory(), this->backbuffer->GetPitch(), this->clipRect,
+                     xMid + (this->backbuffer->GetWidth() / 2), (this->backbuffer->GetHeight() / 2) - yMid,
+                     extent, this->spanLefts, this->spanRights, value, mode, this->spanBuffer.data());
+    }
+    
+    // Many independent lines of one color. The color is packed once and
+    // lines inside the clip rect are stepped without bounds checks.
+    void DrawLines(const Line* lines, const int count, const Color& color)
+    {
+        const int halfWidth = this->backbuffer->GetWidth() / 2;
+        const int halfHeight = this->backbuffer->GetHeight() / 2;
+        unsigned char* memory = this->backbuffer->GetMemory();
+        const int pitch = this->backbuffer->GetPitch();
+        const unsigned int value = ToArgb8888(color);
+        
+        for (int i = 0; i < count; ++i)
+        {
+            DrawLinePixels(memory, pitch, this->clipRect,
+                           lines[i].x0 + halfWidth, halfHeight - lines[i].y0,
+                           lines[i].x1 + halfWidth, halfHeight - lines[i].y1, value);
+        }
+    }
+    
+    // Connected lines through count points
+    void DrawPolyline(const Vec2<int>* points, const int count, const Color& color)
+    {
+        const int halfWidth = this->backbuffer->GetWidth() / 2;
+        const int halfHeight = this->backbuffer->GetHeight() / 2;
+        unsigned char* memory = this->backbuffer->GetMemory();
+        const int pitch = this->backbuffer->GetPitch();
+        const unsigned int value = ToArgb8888(color);
+        
+        for (int i = 1; i < count; ++i)
+        {
+            DrawLinePixels(memory, pitch, this->clipRect,
+                           points[i - 1].x + halfWidth, halfHeight - points[i - 1].y,
+                           points[i].x + halfWidth, halfHeight - points[i].y, value);
+        }
+        if (count == 1)
+            this->SetPixel(points[0].x, points[0].y, color);
+    }
+    
+    // Bezier curves, tessellated to within tolerance pixels (adaptive
+    // subdivision plus forward differencing) and drawn as polylines.
+    // Tessellations are cached while the same curve is drawn every frame.
+    void DrawBezier(const QuadraticBezier& curve, const Color& color, const float tolerance = 0.25f)
+    {
+        const std::vector<Vec2<int> >& points = this->curves.Get(curve, tolerance);
+        this->DrawPolyline(points.data(), (int) points.size(), color);
+    }
+    
+    void DrawBezier(const CubicBezier& curve, const Color& color, const float tolerance = 0.25f)
+    {
+        const std::vector<Vec2<int> >& points = this->curves.Get(curve, tolerance);
+        this->DrawPolyline(points.data(), (int) points.size(), color);
+    }
+    
+    void DrawBeziers(const CubicBezier* curves, const int count, const Color& color, const float tolerance = 0.25f)
+    {
+        for (int i = 0; i < count; ++i)
+            this->DrawBezier(curves[i], color, tolerance);
+    }
+    
+    // Anti-aliased fill of the path (nonzero rule) in one pass over its
+    // edges, see CoverageBuffer. Only the bounding box of the path inside
+    // the clip rect is accumulated and resolved.
+    void FillPath(const Path& path, const Color& color)
+    {
+        const std::vector<Vec2<float> >& points = path.GetPoints();
+        if (points.size() < 3)
+            return;
+        
+        // Pixel (x, y) covers [x, x + 1) x [y, y + 1) of the coverage
+        // buffer, so pixel centers are at +0.5
+        const float originX = this->backbuffer->GetWidth() / 2 + 0.5f;
+        const float originY = this->backbuffer->GetHeight() / 2 + 0.5f;
+        float minX = points[0].x, maxX = points[0].x, minY = points[0].y, maxY = points[0].y;
+        for (int i = 1; i < (int) points.size(); ++i)
+        {
+            minX = std::min(minX, points[i].x);
+            maxX = std::max(maxX, points[i].x);
+            minY = std::min(minY, points[i].y);
+            maxY = std::max(maxY, points[i].y);
+        }
+        
+        const ClipRect& clip = this->clipRect;
+        const int xBegin = std::max((int) floorf(originX + minX), clip.minX);
+        const int xEnd = std::min((int) ceilf(originX + maxX), clip.maxX + 1);
+        const int yBegin = std::max((int) floorf(originY - maxY), clip.minY);
+        const int yEnd = std::min((int) ceilf(originY - minY), clip.maxY + 1);
+        if (xBegin >= xEnd || yBegin >= yEnd)
+            return;
+        
+        this->coverage.Reset(xEnd - xBegin, yEnd - yBegin);
+        const float offsetX = originX - xBegin;
+        const float offsetY = originY - yBegin;
+        for (int contour = 0; contour < path.GetContourCount(); ++contour)
+        {
+            // Contours are closed from their last point to the first
+            const int begin = path.GetContourBegin(contour);
+            const int end = path.GetContourEnd(contour);
+            for (int i = begin; i < end; ++i)
+            {
+                const Vec2<float>& p0 = points[i];
+                const Vec2<float>& p1 = points[i + 1 < end ? i + 1 : begin];
+                this->coverage.AddLine(offsetX + p0.x, offsetY - p0.y, offsetX + p1.x, offsetY - p1.y);
+            }
+        }
+        
+        this->coverage.Resolve(this->backbuffer->GetMemory(), this->backbuffer->GetPitch(), xBegin, yBegin,
+                               Premultiply(color), GetKernels().blendSpan[(int) BlendMode::SrcOver]);
+    }
+    
+    // Line of any width, a rectangle filled as spans
+    void DrawThickLine(const Line& line, const float width, const Color& color,
+                       const BlendMode mode = BlendMode::SrcOver)
+    {
+        const Vec2<int> points[2] = { Vec2<int>(line.x0, line.y0), Vec2<int>(line.x1, line.y1) };
+        this->DrawThickPolyline(points, 2, width, color, LineJoin::Bevel, mode);
+    }
+    
+    // Polyline of any width: one rectangle per segment plus a join piece at
+    // every inner vertex. The pieces overlap on the inside of turns and at
+    // round joins, so they are gathered in a StrokeMask and every covered
+    // pixel is blended once. Ends are butt, a line of width 1 or less is a
+    // plain polyline.
+    void DrawThickPolyline(const Vec2<int>* points, const int count, const float width, const Color& color,
+                           const LineJoin join = LineJoin::Miter, const BlendMode mode = BlendMode::SrcOver)
+    {
+        if (width <= 1.0f)
+        {
+            this->DrawPolyline(points, count, color);
+            return;
+        }
+        
+        // Backbuffer coordinates without repeated points
+        const int halfWidth = this->backbuffer->GetWidth() / 2;
+        const int halfHeight = this->backbuffer->GetHeight() / 2;
+        this->strokePoints.clear();
+        for (int i = 0; i < count; ++i)
+        {
+            const Vec2<float> point((float) (points[i].x + halfWidth), (float) (halfHeight - points[i].y));
+            if (this->strokePoints.empty() || point.x != this->strokePoints.back().x || point.y != this->strokePoints.back().y)
+                this->strokePoints.push_back(point);
+        }
+        if (this->strokePoints.size() < 2)
+            return;
+        
+        // Nothing reaches further from the points than a miter at the limit
+        const float halfLine = width * 0.5f;
+        const int radius = (int) (halfLine + 0.5f);
+        const float reach = halfLine * MiterLimit + 1.0f;
+        float minX = this->strokePoints[0].x, maxX = minX;
+        float minY = this->strokePoints[0].y, maxY = minY;
+        for (size_t i = 1; i < this->strokePoints.size(); ++i)
+        {
+            minX = std::min(minX, this->strokePoints[i].x);
+            maxX = std::max(maxX, this->strokePoints[i].x);
+            minY = std::min(minY, this->strokePoints[i].y);
+            maxY = std::max(maxY, this->strokePoints[i].y);
+        }
+        const ClipRect& clip = this->clipRect;
+        ClipRect bounds;
+        bounds.minX = std::max((int) floorf(minX - reach), clip.minX);
+        bounds.minY = std::max((int) floorf(minY - reach), clip.minY);
+        bounds.maxX = std::min((int) ceilf(maxX + reach), clip.maxX);
+        bounds.maxY = std::min((int) ceilf(maxY + reach), clip.maxY);
+        if (!this->strokeMask.Reset(bounds))
+            return;
+        
+        Vec2<float> previousNormal;
+        for (int i = 0; i + 1 < (int) this->strokePoints.size(); ++i)
+        {
+            const Vec2<float>& p0 = this->strokePoints[i];
+            const Vec2<float>& p1 = this->strokePoints[i + 1];
+            const float dx = p1.x - p0.x, dy = p1.y - p0.y;
+            const float scale = halfLine / sqrtf(dx * dx + dy * dy);
+            const Vec2<float> normal(-dy * scale, dx * scale);
+            
+            Vec2<float> polygon[4];
+            SegmentQuad(p0, p1, normal, polygon);
+            this->strokeMask.AddPolygon(polygon, 4);
+            
+            if (i > 0 && join == LineJoin::Round)
+            {
+                this->strokeMask.AddDisc((int) p0.x, (int) p0.y, this->circles.Get(radius).halfWidths);
+            }
+            else if (i > 0)
+            {
+                const int joinCount = JoinPolygon(p0, previousNormal, normal, join, polygon);
+                if (joinCount > 0)
+                    this->strokeMask.AddPolygon(polygon, joinCount);
+            }
+            previousNormal = normal;
+        }
+        
+        const unsigned int value = Premultiply(color);
+        if (mode != BlendMode::Opaque)
+            this->spanBuffer.assign(bounds.maxX - bounds.minX + 1, value);
+        this->strokeMask.Resolve(this->backbuffer->GetMemory(), this->backbuffer->GetPitch(), value, mode,
+                                 this->spanBuffer.data());
+    }
+    
+    // Replaces the 4-connected region of pixels with the color of pixel
+    // (x, y) by color, inside the clip rect. Returns the number of pixels
+    // filled. The parallel fill pays off for large regions.
+    int FloodFill(const int x, const int y, const Color& color, const bool parallel = false)
+    {
+        const int xPos = x + (this->backbuffer->GetWidth() / 2);
+        const int yPos = (this->backbuffer->GetHeight() / 2) - y;
+        unsigned char* memory = this->backbuffer->GetMemory();
+        const int pitch = this->backbuffer->GetPitch();
+        
+        if (parallel)
+            return this->floodFiller.FillParallel(memory, pitch, this->clipRect, xPos, yPos, ToArgb8888(color));
+        return this->floodFiller.Fill(memory, pitch, this->clipRect, xPos, yPos, ToArgb8888(color));
+    }
+    
+    // Sprite with its top left pixel at (x, y)
+    void DrawSprite(const Sprite& sprite, const int x, const int y)
+    {
+        sprite.Blit(this->backbuffer->GetMemory(), this->backbuffer->GetPitch(), this->clipRect,
+                    x + (this->backbuffer->GetWidth() / 2), (this->backbuffer->GetHeight() / 2) - y);
+    }
+    
+private:
+    // Circle i has radius radii[i * radiusStride]
+    static bool IsCircleVisible(const ClipRect& clip, const int x, const int y, const int radius, const bool filled)
+    {
+        if (filled)
+            return clip.Intersects(x - radius, y - radius, x + radius, y + radius);
+        return CircleOutlineIntersects(clip, x, y, radius);
+    }
+    
+    void DrawCircleBatch(const Vec2<int>* centers, const int* radii, const int radiusStride, const int count,
+                         const Color& color, const bool filled, const BlendMode mode)
+    {
+        // Build the missing shapes of the visible circles up front, after
+        // this the cache is only read
+        const int halfWidth = this->backbuffer->GetWidth() / 2;
+        const int halfHeight = this->backbuffer->GetHeight() / 2;
+        const ClipRect clip = this->clipRect;
+        bool any = false;
+        for (int i = 0; i < count; ++i)
+        {
+            const int radius = radii[i * radiusStride];
+            const int x = centers[i].x + halfWidth;
+            const int y = halfHeight - centers[i].y;
+            if (radius >= 0 && IsCircleVisible(clip, x, y, radius, filled))
+            {
+                this->circles.Get(radius);
+                any = true;
+            }
+        }
+        if (!any)
+            return;
+        
+        // Spans are clipped, so never wider than the clip rect
+        const unsigned int value = filled ? Premultiply(color) : ToArgb8888(color);
+        if (filled && mode != BlendMode::Opaque)
+            this->spanBuffer.assign(clip.maxX - clip.minX + 1, value);
+        
+        // Bands of rows are independent, each draws the circles that
+        // overlap it clipped to the band, in order, so the result is the
+        // same as drawing them one by one. A circle visible in a band is
+        // visible in the clip rect, so its shape is built.
+        unsigned char* memory = this->backbuffer->GetMemory();
+        const int pitch = this->backbuffer->GetPitch();
+        const unsigned int* source = this->spanBuffer.data();
+        const CircleCache& circles = this->circles;
+        const int bandHeight = 32;
+        const int bandCount = (clip.maxY - clip.minY + bandHeight) / bandHeight;
+        
+        #pragma omp parallel for schedule(dynamic) if (count > 64)
+        for (int band = 0; band < bandCount; ++band)
+        {
+            ClipRect bandClip = clip;
+            bandClip.minY = clip.minY + band * bandHeight;
+            bandClip.maxY = std::min(bandClip.minY + bandHeight - 1, clip.maxY);
+            
+            for (int i = 0; i < count; ++i)
+            {
+                const int radius = radii[i * radiusStride];
+                const int x = centers[i].x + halfWidth;
+                const int y = halfHeight - centers[i].y;
+                if (radius < 0 || !IsCircleVisible(bandClip, x, y, radius, filled))
+                    continue;
+                
+                const CircleShape& shape = circles[radius];
+                if (filled)
+                    FillCircleRows(memory, pitch, bandClip, x, y, shape.halfWidths, value, mode, source);
+                else
+                    DrawCircleOctants(memory, pitch, bandClip, x, y, shape.steps, value);
+            }
+        }
+    }
 };
 
 bool HandleEvent(const SDL_Event& event);
@@ -0,0 +1,134 @@
+#pragma once
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include "clip.h"
+#include "kernels.h"
+
+enum class SpriteMode
+{
+    Opaque,     // Every pixel is copied
+    ColorKey,   // Pixels equal to the key are left out, the rest copied
+    Alpha,      // Straight alpha: 0 left out, 255 copied, the rest blended
+};
+
+// Run length encoded sprite: every row is a list of runs of visible pixels,
+// transparent pixels between them are not stored and cost nothing to draw.
+// Runs are either fully opaque, and copied, or translucent and blended.
+class Sprite
+{
+private:
+    struct Run
+    {
+        int     x;          // First pixel in the row
+        int     count;
+        int     offset;     // First pixel in pixels
+        bool    blend;
+    };
+    
+    std::vector<Run>            runs;
+    std::vector<int>            rows;       // First run of every row, and the end
+    std::vector<unsigned int>   pixels;     // Premultiplied ARGB8888
+    int                         width;
+    int                         height;
+    
+    // 0 transparent, 1 opaque, 2 translucent
+    static inline int Classify(const unsigned int texel, const SpriteMode mode, const unsigned int colorKey)
+    {
+        if (mode == SpriteMode::Opaque)
+            return 1;
+        if (mode == SpriteMode::ColorKey)
+            return texel == colorKey ? 0 : 1;
+        
+        const unsigned int a = texel >> 24;
+        return a == 0 ? 0 : (a == 255 ? 1 : 2);
+    }
+    
+public:
+    Sprite()
+        : width(0), height(0)
+    {
+    }
+    
+    // Encodes row-major, straight alpha ARGB8888 pixels. colorKey is only
+    // used with SpriteMode::ColorKey.
+    bool Create(const unsigned int* argb, const int width, const int height, const SpriteMode mode,
+                const unsigned int colorKey = 0)
+    {
+        if (width <= 0 || height <= 0)
+        {
+            std::cout << "Could not create sprite: " << width << "x" << height << " is empty" << std::endl;
+            return false;
+        }
+        
+        this->width = width;
+        this->height = height;
+        this->runs.clear();
+        this->rows.clear();
+        this->pixels.clear();
+        
+        for (int y = 0; y < height; ++y)
+        {
+            this->rows.push_back((int) this->runs.size());
+            const unsigned int* row = argb + y * width;
+            int x = 0;
+            while (x < width)
+            {
+                const int kind = Classify(row[x], mode, colorKey);
+                int end = x + 1;
+                while (end < width && Classify(row[end], mode, colorKey) == kind)
+                    ++end;
+                
+                if (kind != 0)
+                {
+                    const Run run = { x, end - x, (int) this->pixels.size(), kind == 2 };
+                    this->runs.push_back(run);
+                    for (int i = x; i < end; ++i)
+                    {
+                        const unsigned int a = mode == SpriteMode::Alpha ? row[i] >> 24 : 255;
+                        this->pixels.push_back((a << 24) | (Div255(((row[i] >> 16) & 0xFF) * a) << 16)
+                                             | (Div255(((row[i] >> 8) & 0xFF) * a) << 8) | Div255((row[i] & 0xFF) * a));
+                    }
+                }
+                x = end;
+            }
+        }
+        this->rows.push_back((int) this->runs.size());
+        return true;
+    }
+    
+    inline int GetWidth() const { return this->width; }
+    inline int GetHeight() const { return this->height; }
+    inline int GetRunCount() const { return (int) this->runs.size(); }
+    
+    // Draws the sprite with its top left pixel at (x, y) in backbuffer
+    // coordinates. Runs are clipped as a whole; opaque ones go through the
+    // copy (Opaque blend) span kernel, translucent ones through SrcOver.
+    void Blit(unsigned char* target, const int pitch, const ClipRect& clip, const int x, const int y) const
+    {
+        if (!clip.Intersects(x, y, x + this->width - 1, y + this->height - 1))
+            return;
+        
+        const Kernels& kernels = GetKernels();
+        void (*copy)(unsigned int*, const unsigned int*, int) = kernels.blendSpan[(int) BlendMode::Opaque];
+        void (*blend)(unsigned int*, const unsigned int*, int) = kernels.blendSpan[(int) BlendMode::SrcOver];
+        const int rowBegin = std::max(clip.minY - y, 0);
+        const int rowEnd = std::min(clip.maxY - y + 1, this->height);
+        
+        for (int row = rowBegin; row < rowEnd; ++row)
+        {
+            unsigned int* line = (unsigned int*) (target + (y + row) * pitch);
+            for (int i = this->rows[row]; i < this->rows[row + 1]; ++i)
+            {
+                const Run& run = this->runs[i];
+                const int begin = std::max(x + run.x, clip.minX);
+                const int end = std::min(x + run.x + run.count, clip.maxX + 1);
+                if (begin >= end)
+                    continue;
+                
+                const unsigned int* source = this->pixels.data() + run.offset + (begin - x - run.x);
+                (run.blend ? blend : copy)(line + begin, source, end - begin);
+            }
+        }
+    }
+};
\ No newline at end of file
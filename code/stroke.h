@@ -0,0 +1,238 @@
+#pragma once
+#include <cmath>
+#include <vector>
+#include <climits>
+#include <cstring>
+#include <algorithm>
+#include "math/vec2.h"
+#include "clip.h"
+#include "kernels.h"
+
+enum class LineJoin
+{
+    Miter,      // Edges extended until they meet, bevel past MiterLimit
+    Round,      // Disc around the vertex
+    Bevel,      // Outer corners connected straight
+};
+
+// Longest miter, in line widths, before it turns into a bevel (like SVG)
+const float MiterLimit = 4.0f;
+
+// Spans of a convex polygon in backbuffer coordinates, pixel centers at
+// integers: rows whose center is inside, from the left edge up to but not
+// including the right one (top-left rule), so pieces sharing an edge do not
+// overlap. Every edge widens the span of the rows it crosses, like the
+// scanbuffer of FillShape. Row y in [*yBegin, *yEnd) spans from
+// ceilf(lefts[y - *yBegin]) to ceilf(rights[y - *yBegin]), unclipped.
+// Returns false if no row is inside clip.
+inline bool ConvexPolygonSpans(const ClipRect& clip, const Vec2<float>* points, const int count,
+                               std::vector<float>* lefts, std::vector<float>* rights, int* yBegin, int* yEnd)
+{
+    float minY = points[0].y, maxY = points[0].y;
+    for (int i = 1; i < count; ++i)
+    {
+        minY = std::min(minY, points[i].y);
+        maxY = std::max(maxY, points[i].y);
+    }
+    *yBegin = std::max((int) ceilf(minY), clip.minY);
+    *yEnd = std::min((int) ceilf(maxY), clip.maxY + 1);
+    if (*yBegin >= *yEnd)
+        return false;
+    
+    lefts->assign(*yEnd - *yBegin, 1e30f);
+    rights->assign(*yEnd - *yBegin, -1e30f);
+    for (int i = 0; i < count; ++i)
+    {
+        const Vec2<float>& a = points[i];
+        const Vec2<float>& b = points[i + 1 < count ? i + 1 : 0];
+        if (a.y == b.y)
+            continue;
+        
+        const Vec2<float>& top = a.y < b.y ? a : b;
+        const Vec2<float>& bottom = a.y < b.y ? b : a;
+        const float slope = (bottom.x - top.x) / (bottom.y - top.y);
+        const int rowBegin = std::max((int) ceilf(top.y), *yBegin);
+        const int rowEnd = std::min((int) ceilf(bottom.y), *yEnd);
+        for (int y = rowBegin; y < rowEnd; ++y)
+        {
+            const float x = top.x + (y - top.y) * slope;
+            (*lefts)[y - *yBegin] = std::min((*lefts)[y - *yBegin], x);
+            (*rights)[y - *yBegin] = std::max((*rights)[y - *yBegin], x);
+        }
+    }
+    return true;
+}
+
+// Pixels covered by a stroke, one byte each over its clipped bounding box.
+// The pieces of a stroke overlap at every join and where the line crosses
+// itself, so they are only marked here and each run of marked pixels is
+// blended once: translucent strokes come out even. The cells are all zero
+// between strokes, only the marked range of each row is scanned.
+class StrokeMask
+{
+private:
+    std::vector<unsigned char>  cells;
+    std::vector<int>            rowMins;    // Marked range of each row, inclusive
+    std::vector<int>            rowMaxs;
+    std::vector<float>          lefts;
+    std::vector<float>          rights;
+    ClipRect                    bounds;
+    int                         width;
+    
+    void Mark(const int y, const int xBegin, const int xEnd)
+    {
+        const int begin = std::max(xBegin, this->bounds.minX);
+        const int end = std::min(xEnd, this->bounds.maxX + 1);
+        if (y < this->bounds.minY || y > this->bounds.maxY || begin >= end)
+            return;
+        
+        const int row = y - this->bounds.minY;
+        memset(this->cells.data() + row * this->width + (begin - this->bounds.minX), 1, end - begin);
+        this->rowMins[row] = std::min(this->rowMins[row], begin);
+        this->rowMaxs[row] = std::max(this->rowMaxs[row], end - 1);
+    }
+    
+public:
+    StrokeMask()
+        : width(0)
+    {
+        this->bounds.minX = this->bounds.minY = 0;
+        this->bounds.maxX = this->bounds.maxY = -1;
+    }
+    
+    // Starts a stroke inside bounds (backbuffer coordinates, clipped by the
+    // caller). Returns false if they are empty.
+    bool Reset(const ClipRect& bounds)
+    {
+        this->bounds = bounds;
+        if (bounds.IsEmpty())
+            return false;
+        
+        this->width = bounds.maxX - bounds.minX + 1;
+        const int height = bounds.maxY - bounds.minY + 1;
+        if (this->cells.size() < (size_t) this->width * height)
+            this->cells.resize((size_t) this->width * height, 0);
+        this->rowMins.assign(height, INT_MAX);
+        this->rowMaxs.assign(height, INT_MIN);
+        return true;
+    }
+    
+    // Convex polygon, see ConvexPolygonSpans
+    void AddPolygon(const Vec2<float>* points, const int count)
+    {
+        int yBegin, yEnd;
+        if (!ConvexPolygonSpans(this->bounds, points, count, &this->lefts, &this->rights, &yBegin, &yEnd))
+            return;
+        
+        for (int y = yBegin; y < yEnd; ++y)
+            this->Mark(y, (int) ceilf(this->lefts[y - yBegin]), (int) ceilf(this->rights[y - yBegin]));
+    }
+    
+    // Disc of row half widths (see CircleSpans) around (xMid, yMid)
+    void AddDisc(const int xMid, const int yMid, const std::vector<int>& halfWidths)
+    {
+        const int radius = (int) halfWidths.size() - 1;
+        for (int y = yMid - radius; y <= yMid + radius; ++y)
+        {
+            const int halfWidth = halfWidths[std::abs(y - yMid)];
+            this->Mark(y, xMid - halfWidth, xMid + halfWidth + 1);
+        }
+    }
+    
+    // Blends every run of marked pixels once and clears the mask. source
+    // holds the premultiplied color for at least the bounds width.
+    void Resolve(unsigned char* pixels, const int pitch, const unsigned int value, const BlendMode mode,
+                 const unsigned int* source)
+    {
+        if (this->bounds.IsEmpty())
+            return;
+        
+        const Kernels& kernels = GetKernels();
+        const int height = this->bounds.maxY - this->bounds.minY + 1;
+        for (int row = 0; row < height; ++row)
+        {
+            if (this->rowMins[row] > this->rowMaxs[row])
+                continue;
+            
+            // Cell i of the row is pixel minX + i
+            const int y = this->bounds.minY + row;
+            unsigned char* cells = this->cells.data() + row * this->width;
+            unsigned int* line = (unsigned int*) (pixels + y * pitch) + this->bounds.minX;
+            const int begin = this->rowMins[row] - this->bounds.minX;
+            const int end = this->rowMaxs[row] + 1 - this->bounds.minX;
+            int i = begin;
+            while (i < end)
+            {
+                if (!cells[i])
+                {
+                    ++i;
+                    continue;
+                }
+                
+                int runEnd = i + 1;
+                while (runEnd < end && cells[runEnd])
+                    ++runEnd;
+                if (mode == BlendMode::Opaque)
+                    kernels.fillSpan(line + i, runEnd - i, value);
+                else
+                    kernels.blendSpan[(int) mode](line + i, source, runEnd - i);
+                i = runEnd;
+            }
+            memset(cells + begin, 0, end - begin);
+        }
+        
+        this->bounds.maxX = this->bounds.minX - 1;
+    }
+};
+
+// Rectangle of a thick segment: p0 and p1 moved both ways along the normal
+inline void SegmentQuad(const Vec2<float>& p0, const Vec2<float>& p1, const Vec2<float>& normal,
+                        Vec2<float> quad[4])
+{
+    quad[0] = Vec2<float>(p0.x + normal.x, p0.y + normal.y);
+    quad[1] = Vec2<float>(p1.x + normal.x, p1.y + normal.y);
+    quad[2] = Vec2<float>(p1.x - normal.x, p1.y - normal.y);
+    quad[3] = Vec2<float>(p0.x - normal.x, p0.y - normal.y);
+}
+
+// Polygon filling the gap on the outside of the vertex p between the
+// segments with normals n0 (in) and n1 (out), both half the line width
+// long and turned +90 degrees from their direction. Returns the number of
+// points, 0 when the segments are straight in line. Round joins are discs
+// and left to the caller, see StrokeMask.
+inline int JoinPolygon(const Vec2<float>& p, const Vec2<float>& n0, const Vec2<float>& n1,
+                       const LineJoin join, Vec2<float> polygon[4])
+{
+    // Direction is the normal turned back -90 degrees, only the sign of
+    // the cross product matters
+    const float cross = n0.x * n1.y - n0.y * n1.x;
+    const float halfWidth2 = n0.x * n0.x + n0.y * n0.y;
+    if (fabsf(cross) <= halfWidth2 * 1e-6f && n0.x * n1.x + n0.y * n1.y > 0)
+        return 0;
+    
+    // The outer side is away from the turn
+    const float side = cross > 0 ? -1.0f : 1.0f;
+    const Vec2<float> a(p.x + side * n0.x, p.y + side * n0.y);
+    const Vec2<float> b(p.x + side * n1.x, p.y + side * n1.y);
+    polygon[0] = p;
+    polygon[1] = a;
+    
+    if (join == LineJoin::Miter)
+    {
+        // The tip is 1 / cos(half the angle) half widths out along the
+        // bisector of the normals
+        const float bx = n0.x + n1.x, by = n0.y + n1.y;
+        const float bisector2 = bx * bx + by * by;
+        const float cosHalf2 = bisector2 / (4 * halfWidth2);
+        if (cosHalf2 > 0 && 1.0f / cosHalf2 <= MiterLimit * MiterLimit)
+        {
+            const float scale = side * halfWidth2 * 2 / bisector2;
+            polygon[2] = Vec2<float>(p.x + bx * scale, p.y + by * scale);
+            polygon[3] = b;
+            return 4;
+        }
+    }
+    
+    polygon[2] = b;
+    return 3;
+}
\ No newline at end of file
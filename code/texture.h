@@ -0,0 +1,260 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include <emmintrin.h>
+#include "math/fastmath.h"
+#include "kernels.h"
+
+enum class TextureFilter
+{
+    None,       // Not textured
+    Nearest,    // Nearest texel of the nearest mip level
+    Bilinear,   // Bilinear in the nearest mip level
+    Trilinear,  // Bilinear in the two nearest mip levels, blended
+    Count,
+};
+
+// ARGB8888 texture with power of two dimensions and a full mip chain,
+// addressed with wrapping. Texels are stored in 4x4 tiles of one cache
+// line each, Morton order inside a tile, so neighbours in both u and v
+// are close in memory whatever the direction triangles are drawn in.
+class Texture
+{
+private:
+    static const int MaxLevels = 16;
+
+    struct Level
+    {
+        int     offset;         // First texel in texels
+        int     width;
+        int     height;
+        int     tileRowShift;   // log2 of the tiles per row
+    };
+
+    std::vector<unsigned int>   texels;
+    Level                       levels[MaxLevels];
+    int                         levelCount;
+
+    // Position of texel (x, y) inside its level
+    static inline int TexelIndex(const Level& level, const int x, const int y)
+    {
+        const int tile = ((y >> 2) << level.tileRowShift) + (x >> 2);
+        const int inTile = (x & 1) | ((y & 1) << 1) | ((x & 2) << 1) | ((y & 2) << 2);
+        return (tile << 4) + inTile;
+    }
+
+    static inline __m128i TexelIndex4(const Level& level, const __m128i x, const __m128i y)
+    {
+        const __m128i one = _mm_set1_epi32(1);
+        const __m128i two = _mm_set1_epi32(2);
+        const __m128i tile = _mm_add_epi32(_mm_sll_epi32(_mm_srli_epi32(y, 2), _mm_cvtsi32_si128(level.tileRowShift)),
+                                           _mm_srli_epi32(x, 2));
+        const __m128i inTile = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(x, one), _mm_slli_epi32(_mm_and_si128(y, one), 1)),
+            _mm_or_si128(_mm_slli_epi32(_mm_and_si128(x, two), 1), _mm_slli_epi32(_mm_and_si128(y, two), 2)));
+        return _mm_add_epi32(_mm_slli_epi32(tile, 4), inTile);
+    }
+
+    // 4 texels of a level at integer coordinates, wrapped. No gather in
+    // SSE2, so the loads themselves are scalar.
+    inline __m128i Fetch4(const Level& level, const __m128i x, const __m128i y) const
+    {
+        const __m128i wrappedX = _mm_and_si128(x, _mm_set1_epi32(level.width - 1));
+        const __m128i wrappedY = _mm_and_si128(y, _mm_set1_epi32(level.height - 1));
+        int indices[4];
+        _mm_storeu_si128((__m128i*) indices, TexelIndex4(level, wrappedX, wrappedY));
+        const unsigned int* texels = this->texels.data() + level.offset;
+        return _mm_setr_epi32(texels[indices[0]], texels[indices[1]], texels[indices[2]], texels[indices[3]]);
+    }
+
+    static inline void Unpack4(const __m128i texels, __m128* r, __m128* g, __m128* b, __m128* a)
+    {
+        const __m128i byteMask = _mm_set1_epi32(0xFF);
+        const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+        *r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texels, 16), byteMask)), scale);
+        *g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texels, 8), byteMask)), scale);
+        *b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(texels, byteMask)), scale);
+        *a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(texels, 24)), scale);
+    }
+
+    inline void SampleNearest4(const Level& level, const __m128 u, const __m128 v,
+                               __m128* r, __m128* g, __m128* b, __m128* a) const
+    {
+        const __m128i x = _mm_cvttps_epi32(Floor4(_mm_mul_ps(u, _mm_set1_ps((float) level.width))));
+        const __m128i y = _mm_cvttps_epi32(Floor4(_mm_mul_ps(v, _mm_set1_ps((float) level.height))));
+        Unpack4(this->Fetch4(level, x, y), r, g, b, a);
+    }
+
+    inline void SampleBilinear4(const Level& level, const __m128 u, const __m128 v,
+                                __m128* r, __m128* g, __m128* b, __m128* a) const
+    {
+        // Texel centers are at +0.5
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 tu = _mm_sub_ps(_mm_mul_ps(u, _mm_set1_ps((float) level.width)), half);
+        const __m128 tv = _mm_sub_ps(_mm_mul_ps(v, _mm_set1_ps((float) level.height)), half);
+        const __m128 floorU = Floor4(tu);
+        const __m128 floorV = Floor4(tv);
+        const __m128 fu = _mm_sub_ps(tu, floorU);
+        const __m128 fv = _mm_sub_ps(tv, floorV);
+        const __m128i x0 = _mm_cvttps_epi32(floorU);
+        const __m128i y0 = _mm_cvttps_epi32(floorV);
+        const __m128i x1 = _mm_add_epi32(x0, _mm_set1_epi32(1));
+        const __m128i y1 = _mm_add_epi32(y0, _mm_set1_epi32(1));
+
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128i corners[4] =
+        {
+            this->Fetch4(level, x0, y0), this->Fetch4(level, x1, y0),
+            this->Fetch4(level, x0, y1), this->Fetch4(level, x1, y1),
+        };
+        const __m128 weights[4] =
+        {
+            _mm_mul_ps(_mm_sub_ps(one, fu), _mm_sub_ps(one, fv)), _mm_mul_ps(fu, _mm_sub_ps(one, fv)),
+            _mm_mul_ps(_mm_sub_ps(one, fu), fv), _mm_mul_ps(fu, fv),
+        };
+
+        *r = *g = *b = *a = _mm_setzero_ps();
+        for (int k = 0; k < 4; ++k)
+        {
+            __m128 cr, cg, cb, ca;
+            Unpack4(corners[k], &cr, &cg, &cb, &ca);
+            *r = _mm_add_ps(*r, _mm_mul_ps(cr, weights[k]));
+            *g = _mm_add_ps(*g, _mm_mul_ps(cg, weights[k]));
+            *b = _mm_add_ps(*b, _mm_mul_ps(cb, weights[k]));
+            *a = _mm_add_ps(*a, _mm_mul_ps(ca, weights[k]));
+        }
+    }
+
+    // 2x2 box filter of one level into the next
+    void Downsample(const Level& source, const Level& target)
+    {
+        for (int y = 0; y < target.height; ++y)
+        {
+            for (int x = 0; x < target.width; ++x)
+            {
+                // Levels with a side of 1 average 2 texels instead of 4
+                const int x0 = std::min(x * 2, source.width - 1), x1 = std::min(x * 2 + 1, source.width - 1);
+                const int y0 = std::min(y * 2, source.height - 1), y1 = std::min(y * 2 + 1, source.height - 1);
+                const unsigned int* s = this->texels.data() + source.offset;
+                const unsigned int quad[4] =
+                {
+                    s[TexelIndex(source, x0, y0)], s[TexelIndex(source, x1, y0)],
+                    s[TexelIndex(source, x0, y1)], s[TexelIndex(source, x1, y1)],
+                };
+
+                unsigned int result = 0;
+                for (int shift = 0; shift < 32; shift += 8)
+                {
+                    unsigned int sum = 2;
+                    for (int k = 0; k < 4; ++k)
+                        sum += (quad[k] >> shift) & 0xFF;
+                    result |= (sum >> 2) << shift;
+                }
+                this->texels[target.offset + TexelIndex(target, x, y)] = result;
+            }
+        }
+    }
+
+public:
+    Texture()
+        : levelCount(0)
+    {
+    }
+
+    // Copies row-major, straight alpha ARGB8888 texels and builds the mip
+    // chain. Texels are kept premultiplied, which filters without dark
+    // fringes around transparent texels.
+    bool Create(const unsigned int* argb, const int width, const int height)
+    {
+        if (width <= 0 || height <= 0 || (width & (width - 1)) || (height & (height - 1)))
+        {
+            std::cout << "Could not create texture: " << width << "x" << height
+                      << " is not a power of two" << std::endl;
+            return false;
+        }
+
+        // Levels smaller than a tile still take a whole tile
+        int offset = 0;
+        this->levelCount = 0;
+        for (int w = width, h = height; ; w = std::max(w / 2, 1), h = std::max(h / 2, 1))
+        {
+            Level& level = this->levels[this->levelCount++];
+            const int tilesPerRow = std::max(w / 4, 1);
+            const int tileRows = std::max(h / 4, 1);
+            level.offset = offset;
+            level.width = w;
+            level.height = h;
+            level.tileRowShift = 0;
+            while ((1 << level.tileRowShift) < tilesPerRow)
+                level.tileRowShift++;
+            offset += tilesPerRow * tileRows * 16;
+
+            if ((w == 1 && h == 1) || this->levelCount == MaxLevels)
+                break;
+        }
+
+        this->texels.assign(offset, 0);
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                const unsigned int texel = argb[y * width + x];
+                const unsigned int a = texel >> 24;
+                const unsigned int premultiplied = (a << 24) | (Div255(((texel >> 16) & 0xFF) * a) << 16)
+                                                 | (Div255(((texel >> 8) & 0xFF) * a) << 8) | Div255((texel & 0xFF) * a);
+                this->texels[TexelIndex(this->levels[0], x, y)] = premultiplied;
+            }
+        }
+        for (int i = 1; i < this->levelCount; ++i)
+            this->Downsample(this->levels[i - 1], this->levels[i]);
+
+        return true;
+    }
+
+    inline int GetWidth() const { return this->levels[0].width; }
+    inline int GetHeight() const { return this->levels[0].height; }
+    inline int GetLevelCount() const { return this->levelCount; }
+
+    inline unsigned int GetTexel(const int level, const int x, const int y) const
+    {
+        const Level& l = this->levels[level];
+        return this->texels[l.offset + TexelIndex(l, x & (l.width - 1), y & (l.height - 1))];
+    }
+
+    // Samples 4 texture coordinates ([0, 1) covers the texture once) at
+    // one level of detail, log2 of texels per pixel, as float channels.
+    // One lod for all 4 keeps the addressing uniform over the block.
+    template<TextureFilter Filter>
+    inline void Sample4(const __m128 u, const __m128 v, const float lod,
+                        __m128* r, __m128* g, __m128* b, __m128* a) const
+    {
+        // Written so that a NaN lod ends up at level 0
+        const float maxLevel = (float) (this->levelCount - 1);
+        const float clamped = lod > 0 ? std::min(lod, maxLevel) : 0.0f;
+        if (Filter == TextureFilter::Trilinear)
+        {
+            const int level = (int) clamped;
+            const float blend = clamped - level;
+            this->SampleBilinear4(this->levels[level], u, v, r, g, b, a);
+            if (blend > 0)
+            {
+                __m128 r1, g1, b1, a1;
+                this->SampleBilinear4(this->levels[level + 1], u, v, &r1, &g1, &b1, &a1);
+                const __m128 t = _mm_set1_ps(blend);
+                *r = _mm_add_ps(*r, _mm_mul_ps(_mm_sub_ps(r1, *r), t));
+                *g = _mm_add_ps(*g, _mm_mul_ps(_mm_sub_ps(g1, *g), t));
+                *b = _mm_add_ps(*b, _mm_mul_ps(_mm_sub_ps(b1, *b), t));
+                *a = _mm_add_ps(*a, _mm_mul_ps(_mm_sub_ps(a1, *a), t));
+            }
+            return;
+        }
+
+        const int level = (int) (clamped + 0.5f);
+        if (Filter == TextureFilter::Bilinear)
+            this->SampleBilinear4(this->levels[level], u, v, r, g, b, a);
+        else
+            this->SampleNearest4(this->levels[level], u, v, r, g, b, a);
+    }
+};
\ No newline at end of file
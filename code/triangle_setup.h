@@ -0,0 +1,123 @@
+#pragma once
+#include <cmath>
+#include <algorithm>
+#include <emmintrin.h>
+#include "math/vec4.h"
+#include "math/fastmath.h"
+
+// Screen space used by the triangle pipeline: pixels, y down, pixel
+// centers at integer coordinates (like SDLRenderer::FillTriangle).
+// After ProjectToScreen z holds NDC depth and w holds 1 / w(clip), which
+// is what perspective correct interpolation needs.
+
+enum class CullMode
+{
+    None,       // Only degenerate and empty triangles are rejected
+    Back,       // Also reject clockwise (in NDC) triangles
+    Front,      // Also reject counter-clockwise (in NDC) triangles
+};
+
+// Perspective divide and viewport transform of count clip space vertices.
+// All of them must be in front of the camera (w > 0).
+inline void ProjectToScreen(const Vec4<float>* clip, Vec4<float>* screen, const int count,
+                            const int width, const int height)
+{
+    // x' = x/w * (width/2) + (width/2 - 0.5), y' likewise but flipped
+    const __m128 scale = _mm_setr_ps(width * 0.5f, -height * 0.5f, 1.0f, 0.0f);
+    const __m128 offset = _mm_setr_ps(width * 0.5f - 0.5f, height * 0.5f - 0.5f, 0.0f, 0.0f);
+    const __m128 wMask = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+
+    for (int i = 0; i < count; ++i)
+    {
+        const __m128 v = _mm_loadu_ps(&clip[i].x);
+        const __m128 inverseW = _mm_div_ps(_mm_set1_ps(1.0f), _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)));
+        __m128 r = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(v, inverseW), scale), offset);
+        r = _mm_or_ps(_mm_andnot_ps(wMask, r), _mm_and_ps(wMask, inverseW));
+        _mm_storeu_ps(&screen[i].x, r);
+    }
+}
+
+// Scalar reference of the CullTriangles test
+inline bool IsTriangleVisible(const Vec4<float>& v0, const Vec4<float>& v1, const Vec4<float>& v2,
+                              const CullMode mode)
+{
+    // With y down, counter-clockwise (front facing) triangles have a
+    // negative area
+    const float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (area == 0 || (mode == CullMode::Back && area > 0) || (mode == CullMode::Front && area < 0))
+        return false;
+
+    const float minX = std::min(v0.x, std::min(v1.x, v2.x));
+    const float maxX = std::max(v0.x, std::max(v1.x, v2.x));
+    const float minY = std::min(v0.y, std::min(v1.y, v2.y));
+    const float maxY = std::max(v0.y, std::max(v1.y, v2.y));
+
+    return -floorf(-minX) <= floorf(maxX) && -floorf(-minY) <= floorf(maxY);
+}
+
+// Rejects triangles at setup time, 4 per iteration:
+// - backfacing (or frontfacing) by the sign of the screen space area
+// - degenerate ones with zero area
+// - small ones whose bounding box contains no pixel center
+// corners holds 3 screen space vertices per triangle (see ProjectToScreen).
+// Writes the indices of the remaining triangles to visible (room for
+// triangleCount entries) and returns how many there are.
+inline int CullTriangles(const Vec4<float>* corners, const int triangleCount, const CullMode mode, int* visible)
+{
+    const __m128 zero = _mm_setzero_ps();
+    int visibleCount = 0;
+    int t = 0;
+
+    for (; t + 4 <= triangleCount; t += 4)
+    {
+        __m128 xs[3], ys[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            // Corner k of 4 triangles, AoS to SoA
+            __m128 a = _mm_loadu_ps(&corners[(t + 0) * 3 + k].x);
+            __m128 b = _mm_loadu_ps(&corners[(t + 1) * 3 + k].x);
+            __m128 c = _mm_loadu_ps(&corners[(t + 2) * 3 + k].x);
+            __m128 d = _mm_loadu_ps(&corners[(t + 3) * 3 + k].x);
+            _MM_TRANSPOSE4_PS(a, b, c, d);
+            xs[k] = a;
+            ys[k] = b;
+        }
+
+        const __m128 area = _mm_sub_ps(
+            _mm_mul_ps(_mm_sub_ps(xs[1], xs[0]), _mm_sub_ps(ys[2], ys[0])),
+            _mm_mul_ps(_mm_sub_ps(ys[1], ys[0]), _mm_sub_ps(xs[2], xs[0])));
+
+        __m128 accept;
+        if (mode == CullMode::Back)
+            accept = _mm_cmplt_ps(area, zero);
+        else if (mode == CullMode::Front)
+            accept = _mm_cmpgt_ps(area, zero);
+        else
+            accept = _mm_cmpneq_ps(area, zero);
+
+        // ceil(min) <= floor(max) on both axes, ceil(a) = -floor(-a)
+        const __m128 minX = _mm_min_ps(xs[0], _mm_min_ps(xs[1], xs[2]));
+        const __m128 maxX = _mm_max_ps(xs[0], _mm_max_ps(xs[1], xs[2]));
+        const __m128 minY = _mm_min_ps(ys[0], _mm_min_ps(ys[1], ys[2]));
+        const __m128 maxY = _mm_max_ps(ys[0], _mm_max_ps(ys[1], ys[2]));
+        const __m128 ceilMinX = _mm_sub_ps(zero, Floor4(_mm_sub_ps(zero, minX)));
+        const __m128 ceilMinY = _mm_sub_ps(zero, Floor4(_mm_sub_ps(zero, minY)));
+        accept = _mm_and_ps(accept, _mm_cmple_ps(ceilMinX, Floor4(maxX)));
+        accept = _mm_and_ps(accept, _mm_cmple_ps(ceilMinY, Floor4(maxY)));
+
+        const int mask = _mm_movemask_ps(accept);
+        for (int k = 0; k < 4; ++k)
+        {
+            visible[visibleCount] = t + k;
+            visibleCount += (mask >> k) & 1;
+        }
+    }
+
+    for (; t < triangleCount; ++t)
+    {
+        if (IsTriangleVisible(corners[t * 3], corners[t * 3 + 1], corners[t * 3 + 2], mode))
+            visible[visibleCount++] = t;
+    }
+
+    return visibleCount;
+}
\ No newline at end of file
@@ -0,0 +1,242 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "math/vec3.h"
+#include "math/vec4.h"
+#include "math/mat4x4.h"
+
+// Reorders triangles for a small LRU post-transform cache, after Tom
+// Forsyth's "Linear-Speed Vertex Cache Optimisation". Vertices score
+// higher the more recently they were used and the fewer triangles they
+// have left, each step emits the best triangle touching the cache.
+inline void OptimizeVertexCache(unsigned int* indices, const int indexCount, const int vertexCount)
+{
+    const int CacheSize = 32;
+    const int MaxValence = 32;
+    const int triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    float cacheScores[CacheSize];
+    for (int i = 0; i < CacheSize; ++i)
+    {
+        // The last triangle's vertices get a fixed score, so it does not
+        // matter in which order they are reused
+        if (i < 3)
+            cacheScores[i] = 0.75f;
+        else
+            cacheScores[i] = powf(1.0f - (float) (i - 3) / (CacheSize - 3), 1.5f);
+    }
+
+    float valenceScores[MaxValence + 1];
+    valenceScores[0] = 0;
+    for (int i = 1; i <= MaxValence; ++i)
+        valenceScores[i] = 2.0f / sqrtf((float) i);
+
+    // Vertex -> triangles adjacency
+    std::vector<int> remaining(vertexCount, 0);
+    for (int i = 0; i < indexCount; ++i)
+        remaining[indices[i]]++;
+
+    std::vector<int> offsets(vertexCount + 1, 0);
+    for (int v = 0; v < vertexCount; ++v)
+        offsets[v + 1] = offsets[v] + remaining[v];
+
+    std::vector<int> adjacency(indexCount);
+    std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+    for (int i = 0; i < indexCount; ++i)
+        adjacency[fill[indices[i]]++] = i / 3;
+
+    std::vector<float> vertexScores(vertexCount);
+    std::vector<float> triangleScores(triangleCount, 0);
+    std::vector<unsigned char> isEmitted(triangleCount, 0);
+
+    for (int v = 0; v < vertexCount; ++v)
+        vertexScores[v] = valenceScores[std::min(remaining[v], MaxValence)];
+    for (int t = 0; t < triangleCount; ++t)
+        for (int k = 0; k < 3; ++k)
+            triangleScores[t] += vertexScores[indices[t * 3 + k]];
+
+    std::vector<unsigned int> output(indexCount);
+    int cache[CacheSize + 3];
+    int cacheCount = 0;
+    int bestTriangle = 0;
+    for (int t = 1; t < triangleCount; ++t)
+    {
+        if (triangleScores[t] > triangleScores[bestTriangle])
+            bestTriangle = t;
+    }
+    int cursor = 0;
+
+    for (int emitted = 0; emitted < triangleCount; ++emitted)
+    {
+        if (bestTriangle < 0)
+        {
+            // Nothing in the cache has triangles left, take the next one
+            while (isEmitted[cursor])
+                cursor++;
+            bestTriangle = cursor;
+        }
+
+        const int t = bestTriangle;
+        isEmitted[t] = 1;
+        const int corners[3] = { (int) indices[t * 3], (int) indices[t * 3 + 1], (int) indices[t * 3 + 2] };
+        for (int k = 0; k < 3; ++k)
+        {
+            output[emitted * 3 + k] = (unsigned int) corners[k];
+
+            // Remove the triangle from the vertex' remaining list
+            const int v = corners[k];
+            int* begin = &adjacency[offsets[v]];
+            for (int i = 0; i < remaining[v]; ++i)
+            {
+                if (begin[i] == t)
+                {
+                    begin[i] = begin[remaining[v] - 1];
+                    break;
+                }
+            }
+            remaining[v]--;
+        }
+
+        // Move the three vertices to the front of the LRU cache
+        int newCache[CacheSize + 3];
+        int newCount = 0;
+        for (int k = 0; k < 3; ++k)
+            newCache[newCount++] = corners[k];
+        for (int i = 0; i < cacheCount; ++i)
+        {
+            const int v = cache[i];
+            if (v != corners[0] && v != corners[1] && v != corners[2])
+                newCache[newCount++] = v;
+        }
+
+        // Rescore everything that was or is in the cache
+        for (int i = 0; i < newCount; ++i)
+        {
+            const int v = newCache[i];
+            const int position = i < CacheSize ? i : -1;
+
+            float score = 0;
+            if (remaining[v] > 0)
+            {
+                score = valenceScores[std::min(remaining[v], MaxValence)];
+                if (position >= 0)
+                    score += cacheScores[position];
+            }
+
+            const float delta = score - vertexScores[v];
+            vertexScores[v] = score;
+            for (int j = 0; j < remaining[v]; ++j)
+                triangleScores[adjacency[offsets[v] + j]] += delta;
+        }
+
+        cacheCount = std::min(newCount, CacheSize);
+        for (int i = 0; i < cacheCount; ++i)
+            cache[i] = newCache[i];
+
+        // Best triangle among those using a cached vertex
+        bestTriangle = -1;
+        float bestScore = -1;
+        for (int i = 0; i < cacheCount; ++i)
+        {
+            const int v = cache[i];
+            for (int j = 0; j < remaining[v]; ++j)
+            {
+                const int candidate = adjacency[offsets[v] + j];
+                if (triangleScores[candidate] > bestScore)
+                {
+                    bestScore = triangleScores[candidate];
+                    bestTriangle = candidate;
+                }
+            }
+        }
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+// Renumbers vertices in order of first use, so vertices used close in time
+// are close in memory (and map to different post-transform cache slots).
+// remap[old] = new. Returns the number of referenced vertices.
+inline int OptimizeVertexFetch(unsigned int* indices, const int indexCount, const int vertexCount,
+                               std::vector<int>* remap)
+{
+    remap->assign(vertexCount, -1);
+    int next = 0;
+    for (int i = 0; i < indexCount; ++i)
+    {
+        int& slot = (*remap)[indices[i]];
+        if (slot < 0)
+            slot = next++;
+        indices[i] = (unsigned int) slot;
+    }
+
+    return next;
+}
+
+// Transforms the corners of indexed triangles, reusing the result for
+// vertices shared with recently transformed triangles. Direct mapped on
+// the vertex index: one compare per corner, no search.
+class PostTransformCache
+{
+private:
+    static const int Size = 64;
+
+    int             tags[Size];
+    Vec4<float>     entries[Size];
+    int             transformCount;
+
+public:
+    PostTransformCache()
+        : transformCount(0)
+    {
+        this->Reset();
+    }
+
+    void Reset()
+    {
+        for (int i = 0; i < Size; ++i)
+            this->tags[i] = -1;
+    }
+
+    // Vertex transforms done since construction, for profiling
+    inline int GetTransformCount() const { return this->transformCount; }
+
+    inline const Vec4<float>& Transform(const Mat4x4<float>& matrix, const int index,
+                                        const float* xs, const float* ys, const float* zs)
+    {
+        const int slot = index & (Size - 1);
+        if (this->tags[slot] != index)
+        {
+            this->tags[slot] = index;
+            this->entries[slot] = matrix * Vec3<float>(xs[index], ys[index], zs[index]);
+            this->transformCount++;
+        }
+
+        return this->entries[slot];
+    }
+
+    // Writes the transformed corners of all triangles to corners
+    // (indexCount entries). Indices are 16 or 32 bit as given by indexSize.
+    void TransformTriangles(const Mat4x4<float>& matrix,
+                            const float* xs, const float* ys, const float* zs,
+                            const void* indices, const int indexSize, const int indexCount,
+                            Vec4<float>* corners)
+    {
+        this->Reset();
+        if (indexSize == 2)
+        {
+            const unsigned short* shortIndices = (const unsigned short*) indices;
+            for (int i = 0; i < indexCount; ++i)
+                corners[i] = this->Transform(matrix, shortIndices[i], xs, ys, zs);
+        }
+        else
+        {
+            const unsigned int* intIndices = (const unsigned int*) indices;
+            for (int i = 0; i < indexCount; ++i)
+                corners[i] = this->Transform(matrix, (int) intIndices[i], xs, ys, zs);
+        }
+    }
+};
\ No newline at end of file